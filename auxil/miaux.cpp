@@ -4,6 +4,12 @@ See http://www.writingshaders.com/ for the current software distribution
 */
 
 #include "slh_aux.h"
+#include "miaux_file_map.h"
+#include "miaux_hair_cache.h"
+#include "miaux_noise.h"
+
+#include <mutex>
+#include <unordered_map>
 
 
 /* Chapter 7 -- Color from position ----------------------------------------- */
@@ -97,6 +103,27 @@ double miaux_summed_noise(
 	return noise_sum / maximum_noise_sum;
 }
 
+/* miaux_summed_noise with the built-in gradient noise of miaux_noise.h in
+   place of mi_unoise_3d, all the octaves are evaluated together. A
+   different pattern, so shaders opt in to it. */
+double miaux_gradient_summed_noise(
+	miVector *point,
+	double summing_weight, double octave_scaling, int octave_count)
+{
+	return miaux_noise_octaves(point->x, point->y, point->z,
+		(float)summing_weight, (float)octave_scaling, octave_count);
+}
+
+/* For volume marchers, count points at a time */
+void miaux_gradient_summed_noise_batch(
+	miScalar *result, miVector *points, int count,
+	double summing_weight, double octave_scaling, int octave_count)
+{
+	static_assert(sizeof(miVector) == 3 * sizeof(miScalar), "miVector must be three packed floats");
+	miaux_noise_octaves_batch(result, &points->x, count,
+		(float)summing_weight, (float)octave_scaling, octave_count);
+}
+
 
 /* Chapter 10 -- The color of edges ----------------------------------------- */
 
@@ -879,6 +906,65 @@ void miaux_random_point_on_sphere(
 
 /* Shader: hair_geo_datafile */
 
+/* Binary cache written by miaux_convert_hair_data_file, the scalars and
+   indices are already laid out for mental ray so they are copied straight
+   out of the mapped file. Returns miFALSE if filename isn't a cache. */
+static miBoolean miaux_read_hair_cache_file(char* filename, miScalar radius)
+{
+	miaux_hair_cache_header header;
+	const char *data;
+	const float *scalars;
+	const int32_t *indices;
+	size_t size;
+	miScalar *hair_scalars;
+	miGeoIndex *harray;
+	miUint h;
+
+	if (!miaux_read_hair_cache_header(filename, &header))
+		return miFALSE;
+
+	data = (const char*)miaux_map_file(filename, &size, 1);
+	if (data == NULL || size < sizeof(header) +
+		(size_t)header.scalar_count * sizeof(float) + ((size_t)header.hair_count + 1) * sizeof(int32_t)) {
+		mi_error("hair cache %s is truncated", filename);
+		if (data != NULL)
+			miaux_unmap_file(data, size);
+		return miTRUE;
+	}
+	scalars = (const float*)(data + sizeof(header));
+	indices = (const int32_t*)(scalars + header.scalar_count);
+
+	/* Every hair starts with its radius inside the scalars, checked before it is patched */
+	for (h = 0; h < header.hair_count; h++)
+		if (indices[h] < 0 || (miUint)indices[h] >= header.scalar_count || indices[h] > indices[h + 1])
+			break;
+	if (h < header.hair_count || (miUint)indices[header.hair_count] != header.scalar_count) {
+		mi_error("hair cache %s has invalid hair offsets", filename);
+		miaux_unmap_file(data, size);
+		return miTRUE;
+	}
+
+	mi_progress("particle bounding box: %f %f %f %f %f %f ",
+		header.bbox_min[0], header.bbox_min[1], header.bbox_min[2],
+		header.bbox_max[0], header.bbox_max[1], header.bbox_max[2]);
+
+	mi_api_hair_info(0, 'r', 1);
+	mi_api_hair_info(0, 't', 1);
+
+	hair_scalars = mi_api_hair_scalars_begin(header.scalar_count);
+	memcpy(hair_scalars, scalars, header.scalar_count * sizeof(float));
+	for (h = 0; h < header.hair_count; h++)
+		hair_scalars[indices[h]] = radius;
+	mi_api_hair_scalars_end(header.scalar_count);
+
+	harray = mi_api_hair_hairs_begin(header.hair_count + 1);
+	memcpy(harray, indices, ((size_t)header.hair_count + 1) * sizeof(int32_t));
+	mi_api_hair_hairs_end();
+
+	miaux_unmap_file(data, size);
+	return miTRUE;
+}
+
 void miaux_read_hair_data_file(char* filename, miScalar radius)
 {
 	int vertex_count, total_vertex_count, hair_scalar_size, vertex_total = 0,
@@ -888,6 +974,9 @@ void miaux_read_hair_data_file(char* filename, miScalar radius)
 	miGeoIndex *harray;
 	FILE *fp;
 
+	if (miaux_read_hair_cache_file(filename, radius))
+		return;
+
 	fp = fopen(filename, "r");
 	fscanf(fp, "%d %d ", &hair_count, &total_vertex_count);
 	fscanf(fp, "%f %f %f %f %f %f ",
@@ -919,10 +1008,12 @@ void miaux_read_hair_data_file(char* filename, miScalar radius)
 		vertex_total += vertex_count * 3 + per_hair_scalars;
 		*hi++ = vertex_total;
 	}
+	fclose(fp);
 	mi_api_hair_scalars_end(hair_scalar_size);
 	harray = mi_api_hair_hairs_begin(index_array_size);
 	memcpy(harray, hair_indices, index_array_size * sizeof(int));
 	mi_api_hair_hairs_end();
+	mi_mem_release(hair_indices);
 }
 
 void miaux_hair_data_file_bounding_box(
@@ -930,6 +1021,13 @@ void miaux_hair_data_file_bounding_box(
 	float *xmin, float *ymin, float *zmin,
 	float *xmax, float *ymax, float *zmax)
 {
+	miaux_hair_cache_header header;
+	if (miaux_read_hair_cache_header(filename, &header)) {
+		*xmin = header.bbox_min[0]; *ymin = header.bbox_min[1]; *zmin = header.bbox_min[2];
+		*xmax = header.bbox_max[0]; *ymax = header.bbox_max[1]; *zmax = header.bbox_max[2];
+		return;
+	}
+
 	int hair_count, data_count;
 	FILE* fp = fopen(filename, "r");
 	fscanf(fp, "%d %d ", &hair_count, &data_count); /* Ignore. */
@@ -1003,7 +1101,7 @@ void miaux_piecewise_sinusoid(
 
 /* Shader: channel_ramp */
 
-miBoolean miaux_release_user_memory(char* shader_name, miState *state, void *params)
+miBoolean miaux_release_user_memory(const char* shader_name, miState *state, void *params)
 {
 	if (params != NULL) {  /* Shader instance exit */
 		void **user_pointer;
@@ -1142,7 +1240,7 @@ void miaux_add_transparent_color(
 	result->a += transparency;
 }
 
-void miaux_total_light_at_point(
+static void miaux_sampled_light_at_point(
 	miColor *result, miVector *point, miState *state,
 	miTag* light, int light_count)
 {
@@ -1161,20 +1259,151 @@ void miaux_total_light_at_point(
 			miaux_add_scaled_color(&sum, &light_color, 1.0);
 
 		if (light_sample_count)
-			miaux_add_scaled_color(result, &sum, 1 / light_sample_count);
+			miaux_add_scaled_color(result, &sum, 1.0 / light_sample_count);
 	}
 	state->point = original_point;
 }
 
+/* The lights are sampled at the corners of a world-space lattice with
+   tolerance spacing, each corner on first use, and the march points
+   interpolate between them. A cache belongs to one light list. Corners are
+   keyed by their full lattice indices; a shard stops storing new corners
+   once it holds MIAUX_LIGHT_CACHE_SHARD_CORNERS, past that they are sampled
+   on every use, which bounds a cache to about 64 MB. Points too far out
+   for their corner indices (and the +1 of the far corners) to fit an int
+   are also sampled directly. */
+#define MIAUX_LIGHT_CACHE_SHARDS 64
+#define MIAUX_LIGHT_CACHE_SHARD_CORNERS (1 << 14)
+#define MIAUX_LIGHT_CACHE_MAX_INDEX (1 << 30)
+
+struct miaux_light_cache_key {
+	int x, y, z;
+
+	bool operator==(const miaux_light_cache_key &other) const {
+		return x == other.x && y == other.y && z == other.z;
+	}
+};
+
+/* 64-bit mix of the three indices, the top bits also pick the shard */
+struct miaux_light_cache_hash {
+	size_t operator()(const miaux_light_cache_key &key) const {
+		return (size_t)hash(key);
+	}
+	static uint64_t hash(const miaux_light_cache_key &key) {
+		uint64_t h = (uint64_t)(uint32_t)key.x * 0x9e3779b97f4a7c15ull;
+		h = (h ^ (h >> 32) ^ (uint32_t)key.y) * 0xbf58476d1ce4e5b9ull;
+		h = (h ^ (h >> 29) ^ (uint32_t)key.z) * 0x94d049bb133111ebull;
+		return h ^ (h >> 31);
+	}
+};
+
+struct miaux_light_cache {
+	miScalar tolerance;
+	struct shard {
+		std::mutex lock;
+		std::unordered_map<miaux_light_cache_key, miColor, miaux_light_cache_hash> lights;
+	} shards[MIAUX_LIGHT_CACHE_SHARDS];
+};
+
+miaux_light_cache *miaux_light_cache_create(miScalar tolerance)
+{
+	miaux_light_cache *cache = new miaux_light_cache;
+	cache->tolerance = tolerance;
+	return cache;
+}
+
+void miaux_light_cache_delete(miaux_light_cache *cache)
+{
+	delete cache;
+}
+
+static void miaux_cached_light_at_corner(
+	miColor *result, int x, int y, int z, miState *state,
+	miTag* light, int light_count, miaux_light_cache *cache)
+{
+	miaux_light_cache_key key = { x, y, z };
+	miaux_light_cache::shard &shard =
+		cache->shards[miaux_light_cache_hash::hash(key) >> 58];
+
+	{
+		std::lock_guard<std::mutex> lock(shard.lock);
+		std::unordered_map<miaux_light_cache_key, miColor, miaux_light_cache_hash>::const_iterator found =
+			shard.lights.find(key);
+		if (found != shard.lights.end()) {
+			*result = found->second;
+			return;
+		}
+	}
+
+	/* Sampled outside the lock, two threads may both fill a corner */
+	miVector corner, point;
+	corner.x = x * cache->tolerance;
+	corner.y = y * cache->tolerance;
+	corner.z = z * cache->tolerance;
+	mi_point_from_world(state, &point, &corner);
+	miaux_sampled_light_at_point(result, &point, state, light, light_count);
+
+	std::lock_guard<std::mutex> lock(shard.lock);
+	if (shard.lights.size() < MIAUX_LIGHT_CACHE_SHARD_CORNERS)
+		shard.lights.insert(std::make_pair(key, *result));
+}
+
+void miaux_total_light_at_point(
+	miColor *result, miVector *point, miState *state,
+	miTag* light, int light_count, miaux_light_cache *cache)
+{
+	if (cache == NULL) {
+		miaux_sampled_light_at_point(result, point, state, light, light_count);
+		return;
+	}
+
+	miVector world;
+	mi_point_to_world(state, &world, point);
+	miScalar fx = world.x / cache->tolerance, fy = world.y / cache->tolerance,
+		fz = world.z / cache->tolerance;
+	if (!(fabs(fx) < MIAUX_LIGHT_CACHE_MAX_INDEX && fabs(fy) < MIAUX_LIGHT_CACHE_MAX_INDEX &&
+		fabs(fz) < MIAUX_LIGHT_CACHE_MAX_INDEX)) {
+		miaux_sampled_light_at_point(result, point, state, light, light_count);
+		return;
+	}
+	int x = (int)floor(fx), y = (int)floor(fy), z = (int)floor(fz);
+	fx -= x; fy -= y; fz -= z;
+
+	miaux_set_channels(result, 0.0);
+	for (int corner = 0; corner < 8; corner++) {
+		int dx = corner & 1, dy = (corner >> 1) & 1, dz = corner >> 2;
+		miScalar weight = (dx ? fx : 1 - fx) * (dy ? fy : 1 - fy) * (dz ? fz : 1 - fz);
+		if (weight <= 0.0)
+			continue;
+
+		miColor corner_light;
+		miaux_cached_light_at_corner(&corner_light, x + dx, y + dy, z + dz,
+			state, light, light_count, cache);
+		miaux_add_scaled_color(result, &corner_light, weight);
+	}
+}
+
+/* Only the part of the ray inside the sphere is marched, the samples
+   stay on the same march_increment steps from start_point. */
 miScalar miaux_fractional_occlusion_at_point(
 	miVector *start_point, miVector *direction,
 	miScalar total_distance, miVector *center, miScalar radius,
 	miScalar unit_density, miScalar march_increment)
 {
-	miScalar distance, occlusion = 0.0;
-	miVector march_point;
+	miScalar distance, end, occlusion = 0.0;
+	miVector march_point, to_center;
 	mi_vector_normalize(direction);
-	for (distance = 0; distance <= total_distance; distance += march_increment) {
+
+	mi_vector_sub(&to_center, center, start_point);
+	miScalar along = mi_vector_dot(&to_center, direction);
+	miScalar discriminant = radius * radius - mi_vector_dot(&to_center, &to_center) + along * along;
+	if (discriminant < 0.0)
+		return 0.0;
+	miScalar half_chord = sqrt(discriminant);
+	end = along + half_chord < total_distance ? along + half_chord : total_distance;
+
+	int step = along - half_chord > 0.0 ? (int)ceil((along - half_chord) / march_increment - 1e-4) : 0;
+	for (; (distance = step * march_increment) <= end; step++) {
 		miaux_point_along_vector(&march_point, start_point, direction, distance);
 		occlusion += miaux_threshold_density(&march_point, center, radius,
 			unit_density, march_increment);
@@ -1189,16 +1418,31 @@ miScalar miaux_fractional_occlusion_at_point(
 
 /* Shader: parameter_volume */
 
+/* With a grid, march steps that land in empty cells are skipped without
+   calling the density shader. */
 miScalar miaux_fractional_shader_occlusion_at_point(
 	miState *state, miVector *start_point, miVector *direction,
 	miScalar total_distance, miTag density_shader,
-	miScalar unit_density, miScalar march_increment)
+	miScalar unit_density, miScalar march_increment,
+	const miaux_density_grid *grid)
 {
 	miScalar density, distance, occlusion = 0.0;
 	miVector march_point;
 	miVector original_point = state->point;
+	int step = 0;
 	mi_vector_normalize(direction);
-	for (distance = 0; distance <= total_distance; distance += march_increment) {
+	while ((distance = step * march_increment) <= total_distance) {
+		if (grid != NULL) {
+			miScalar empty = miaux_density_grid_empty_until(
+				grid, start_point, direction, distance);
+			if (empty > distance) {
+				if (empty >= total_distance)
+					break;
+				int next = (int)ceil(empty / march_increment - 1e-4);
+				step = next > step ? next : step + 1;
+				continue;
+			}
+		}
 		miaux_point_along_vector(&march_point, start_point, direction, distance);
 		state->point = march_point;
 		mi_call_shader_x((miColor*)&density, miSHADER_MATERIAL, state,
@@ -1208,11 +1452,179 @@ miScalar miaux_fractional_shader_occlusion_at_point(
 			occlusion = 1.0;
 			break;
 		}
+		step++;
 	}
 	state->point = original_point;
 	return occlusion;
 }
 
+/* Events of miaux_tracked_shader_occlusion_at_point that take their free
+   flight and delta tracking collision from QMC dimensions */
+#define MIAUX_TRACKING_EVENTS 8
+
+/* xorshift64*, for the rare events past the QMC dimensions */
+static double miaux_tracking_random(unsigned long long *seed)
+{
+	*seed ^= *seed >> 12;
+	*seed ^= *seed << 25;
+	*seed ^= *seed >> 27;
+	return (double)((*seed * 0x2545f4914f6cdd1dull) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Unbiased 1 - transmittance along the ray. Tentative collisions are drawn
+   against majorant, the largest value density_shader returns (the header's
+   max_density for a brick volume), and the shader is only called at those.
+   Unlike the fixed step marchers this is 1 - exp(-optical depth) rather
+   than the optical depth clamped to 1, with noise instead of step size
+   artefacts. A grid lets free flights restart past empty cells. */
+miScalar miaux_tracked_shader_occlusion_at_point(
+	miState *state, miVector *start_point, miVector *direction,
+	miScalar total_distance, miTag density_shader,
+	miScalar unit_density, miScalar majorant, miaux_tracking_mode mode,
+	const miaux_density_grid *grid)
+{
+	miScalar density, distance = 0.0, transmittance = 1.0;
+	miScalar sigma_bar = majorant * unit_density;
+	miVector march_point;
+	miVector original_point = state->point;
+	double sample[2 * MIAUX_TRACKING_EVENTS], flight[2 * MIAUX_TRACKING_EVENTS], u[2];
+	unsigned long long seed;
+	int sample_number = 0, event = 0;
+	miUint n_samples = 1;
+
+	if (sigma_bar <= 0.0)
+		return 0.0;
+
+	/* The number of events isn't known up front: the first ones use the
+	   dimensions of one QMC sample of the state, later ones a generator
+	   seeded from it, so the estimate only depends on the state */
+	while (mi_sample(sample, &sample_number, state, 2 * MIAUX_TRACKING_EVENTS, &n_samples))
+		memcpy(flight, sample, sizeof(flight));
+	seed = (unsigned long long)(flight[0] * 9007199254740992.0) ^ 0x9e3779b97f4a7c15ull;
+	mi_vector_normalize(direction);
+	for (;;) {
+		if (event < MIAUX_TRACKING_EVENTS) {
+			u[0] = flight[2 * event];
+			u[1] = flight[2 * event + 1];
+		}
+		else {
+			u[0] = miaux_tracking_random(&seed);
+			u[1] = miaux_tracking_random(&seed);
+		}
+		event++;
+		distance -= log(1.0 - u[0]) / sigma_bar;
+		if (grid != NULL) {
+			miScalar empty = miaux_density_grid_empty_until(
+				grid, start_point, direction, distance);
+			if (empty > distance) {
+				/* Only null collisions until there, the flight restarts */
+				distance = empty;
+				if (distance >= total_distance)
+					break;
+				continue;
+			}
+		}
+		if (distance >= total_distance)
+			break;
+
+		miaux_point_along_vector(&march_point, start_point, direction, distance);
+		state->point = march_point;
+		mi_call_shader_x((miColor*)&density, miSHADER_MATERIAL, state,
+			density_shader, NULL);
+		miScalar real = miaux_clamp(density * unit_density / sigma_bar, 0.0, 1.0);
+
+		if (mode == MIAUX_DELTA_TRACKING) {
+			if (u[1] < real) {
+				transmittance = 0.0;
+				break;
+			}
+		}
+		else {
+			transmittance *= 1.0 - real;
+			if (transmittance <= 0.0)
+				break;
+		}
+	}
+	state->point = original_point;
+	return 1.0 - transmittance;
+}
+
+/* Walks the grid cells along the ray from distance, returns where the first
+   cell that may hold density starts, or miHUGE_SCALAR if there is none. */
+miScalar miaux_density_grid_empty_until(
+	const miaux_density_grid *grid,
+	miVector *start_point, miVector *direction, miScalar distance)
+{
+	const int n[3] = { grid->nx, grid->ny, grid->nz };
+	miVector p;
+	miScalar pc[3], dc[3], t_enter = 0.0, t_exit = miHUGE_SCALAR;
+	int axis;
+
+	/* Work in cell units */
+	miaux_point_along_vector(&p, start_point, direction, distance);
+	pc[0] = (p.x - grid->origin.x) / grid->cell_size.x;
+	pc[1] = (p.y - grid->origin.y) / grid->cell_size.y;
+	pc[2] = (p.z - grid->origin.z) / grid->cell_size.z;
+	dc[0] = direction->x / grid->cell_size.x;
+	dc[1] = direction->y / grid->cell_size.y;
+	dc[2] = direction->z / grid->cell_size.z;
+
+	/* Clip the ray to the grid */
+	for (axis = 0; axis < 3; axis++) {
+		if (dc[axis] == 0.0) {
+			if (pc[axis] < 0.0 || pc[axis] >= n[axis])
+				return miHUGE_SCALAR;
+			continue;
+		}
+		miScalar t0 = -pc[axis] / dc[axis], t1 = (n[axis] - pc[axis]) / dc[axis];
+		if (t0 > t1) {
+			miScalar t = t0; t0 = t1; t1 = t;
+		}
+		if (t0 > t_enter) t_enter = t0;
+		if (t1 < t_exit) t_exit = t1;
+	}
+	if (t_enter >= t_exit)
+		return miHUGE_SCALAR;
+
+	/* 3D DDA from the entry point */
+	int c[3], cell_step[3];
+	miScalar t_next[3], t_delta[3];
+	for (axis = 0; axis < 3; axis++) {
+		miScalar entry = pc[axis] + dc[axis] * t_enter;
+		c[axis] = (int)floor(entry);
+		if (c[axis] < 0) c[axis] = 0;
+		if (c[axis] >= n[axis]) c[axis] = n[axis] - 1;
+		if (dc[axis] > 0.0) {
+			cell_step[axis] = 1;
+			t_delta[axis] = 1 / dc[axis];
+			t_next[axis] = t_enter + (c[axis] + 1 - entry) * t_delta[axis];
+		}
+		else if (dc[axis] < 0.0) {
+			cell_step[axis] = -1;
+			t_delta[axis] = -1 / dc[axis];
+			t_next[axis] = t_enter + (entry - c[axis]) * t_delta[axis];
+		}
+		else {
+			cell_step[axis] = 0;
+			t_delta[axis] = t_next[axis] = miHUGE_SCALAR;
+		}
+	}
+
+	miScalar t = t_enter;
+	for (;;) {
+		if (grid->max_density[(c[2] * grid->ny + c[1]) * grid->nx + c[0]] > 0.0)
+			return distance + t;
+
+		axis = t_next[0] < t_next[1] ?
+			(t_next[0] < t_next[2] ? 0 : 2) : (t_next[1] < t_next[2] ? 1 : 2);
+		t = t_next[axis];
+		c[axis] += cell_step[axis];
+		if (t >= t_exit || c[axis] < 0 || c[axis] >= n[axis])
+			return miHUGE_SCALAR;
+		t_next[axis] += t_delta[axis];
+	}
+}
+
 
 /* Shader: voxel_density */
 
@@ -1226,7 +1638,30 @@ void miaux_read_volume_block(
 	char* filename,
 	int *width, int *height, int *depth, float* block)
 {
-	int count;
+	int count, x, y, z, opened;
+	miaux_brick_volume volume;
+
+	/* Brick volumes are expanded, use miaux_voxel_density to keep them sparse */
+	opened = miaux_open_brick_volume(filename, &volume);
+	if (opened < 0) {
+		mi_error("brick volume %s is truncated or has invalid bricks", filename);
+		*width = *height = *depth = 0;
+		return;
+	}
+	if (opened) {
+		*width = volume.header->width;
+		*height = volume.header->height;
+		*depth = volume.header->depth;
+		mi_progress("Volume dataset: %dx%dx%d, %u bricks", *width, *height, *depth,
+			volume.header->brick_count);
+		for (z = 0; z < *depth; z++)
+			for (y = 0; y < *height; y++)
+				for (x = 0; x < *width; x++)
+					*block++ = miaux_brick_volume_voxel(&volume, x, y, z);
+		miaux_close_brick_volume(&volume);
+		return;
+	}
+
 	FILE* fp = fopen(filename, "r");
 	if (fp == NULL) {
 		mi_fatal("Error opening file \"%s\".", filename);
@@ -1235,6 +1670,38 @@ void miaux_read_volume_block(
 	count = (*width) * (*height) * (*depth);
 	mi_progress("Volume dataset: %dx%dx%d", *width, *height, *depth);
 	fread(block, sizeof(float), count, fp);
+	fclose(fp);
+}
+
+miScalar miaux_voxel_density(
+	miVector *p, miVector *min_p, miVector *max_p,
+	const miaux_brick_volume *volume)
+{
+	const miaux_volume_bricks_header *h = volume->header;
+	if (!miaux_point_inside(p, min_p, max_p))
+		return 0.0;
+
+	int x = (int)miaux_fit(p->x, min_p->x, max_p->x, 0, h->width - 1);
+	int y = (int)miaux_fit(p->y, min_p->y, max_p->y, 0, h->height - 1);
+	int z = (int)miaux_fit(p->z, min_p->z, max_p->z, 0, h->depth - 1);
+	return miaux_brick_volume_voxel(volume, x, y, z);
+}
+
+/* Each brick covers 8 voxels per axis of the miaux_voxel_density lookup */
+void miaux_brick_volume_density_grid(
+	miaux_density_grid *grid, const miaux_brick_volume *volume,
+	miVector *min_p, miVector *max_p)
+{
+	const miaux_volume_bricks_header *h = volume->header;
+	miScalar brick = MIAUX_BRICK_SIZE;
+	grid->origin = *min_p;
+	grid->cell_size.x = h->width > 1 ? brick * (max_p->x - min_p->x) / (h->width - 1) : max_p->x - min_p->x + 1;
+	grid->cell_size.y = h->height > 1 ? brick * (max_p->y - min_p->y) / (h->height - 1) : max_p->y - min_p->y + 1;
+	grid->cell_size.z = h->depth > 1 ? brick * (max_p->z - min_p->z) / (h->depth - 1) : max_p->z - min_p->z + 1;
+	grid->nx = h->bricks_x;
+	grid->ny = h->bricks_y;
+	grid->nz = h->bricks_z;
+	grid->max_density = volume->max_density;
 }
 
 
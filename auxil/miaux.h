@@ -15,6 +15,7 @@
 #include <sys/types.h>
 #include "shader.h"
 #include "geoshader.h"
+#include "miaux_volume_bricks.h"
 
 typedef struct {
     miScalar x;
@@ -25,6 +26,25 @@ typedef struct {
 
 typedef void (*miaux_bbox_function)(miObject*, void*);
 
+/* Upper bound of a density field over a coarse grid of cells, in the space
+   the occlusion marchers step through. The density must be zero outside
+   the grid and no larger than max_density inside each cell. */
+typedef struct {
+    miVector origin;
+    miVector cell_size;
+    int nx, ny, nz;
+    const float *max_density;   /* per cell, x varying fastest */
+} miaux_density_grid;
+
+/* Incoming light cached on a world-space lattice, see miaux_total_light_at_point */
+typedef struct miaux_light_cache miaux_light_cache;
+
+/* Transmittance estimators for miaux_tracked_shader_occlusion_at_point */
+typedef enum {
+    MIAUX_DELTA_TRACKING,   /* occluded or not, one density lookup per collision */
+    MIAUX_RATIO_TRACKING    /* fractional, lower variance for the same lookups */
+} miaux_tracking_mode;
+
 typedef struct {
     int width;
     int height;
@@ -46,6 +66,12 @@ void miaux_set_vector(miVector *v, double x, double y, double z);
 double miaux_summed_noise ( 
     miVector *point,
     double summing_weight, double octave_scaling, int octave_count);
+double miaux_gradient_summed_noise(
+    miVector *point,
+    double summing_weight, double octave_scaling, int octave_count);
+void miaux_gradient_summed_noise_batch(
+    miScalar *result, miVector *points, int count,
+    double summing_weight, double octave_scaling, int octave_count);
 char* miaux_tag_to_string(miTag tag, char *default_value);
 void miaux_add_scaled_color(miColor *result, miColor *color, miScalar scale);
 miScalar miaux_quantize(miScalar value, miInteger count);
@@ -181,7 +207,7 @@ float miaux_altitude(miState *state);
 void miaux_piecewise_sinusoid(
     miScalar result[], int result_count, 
     int key_count, miScalar key_positions[], miScalar key_values[]);
-miBoolean miaux_release_user_memory(char* shader_name, miState *state, void *params);
+miBoolean miaux_release_user_memory(const char* shader_name, miState *state, void *params);
 void* miaux_user_memory_pointer(miState *state, int allocation_size);
 void miaux_interpolated_color_lookup(miColor* result,
                                      miColor lookup_table[], int table_size,
@@ -206,7 +232,9 @@ void miaux_add_transparent_color(
     miColor *result, miColor *color, miScalar transparency);
 void miaux_total_light_at_point(
     miColor *result, miVector *point, miState *state,
-    miTag* light, int light_count);
+    miTag* light, int light_count, miaux_light_cache *cache = NULL);
+miaux_light_cache *miaux_light_cache_create(miScalar tolerance);
+void miaux_light_cache_delete(miaux_light_cache *cache);
 miScalar miaux_fractional_occlusion_at_point(
     miVector *start_point, miVector *direction, 
     miScalar total_distance, miVector *center, miScalar radius, 
@@ -214,11 +242,26 @@ miScalar miaux_fractional_occlusion_at_point(
 miScalar miaux_fractional_shader_occlusion_at_point(
     miState *state, miVector *start_point, miVector *direction, 
     miScalar total_distance, miTag density_shader,
-    miScalar unit_density, miScalar march_increment);
+    miScalar unit_density, miScalar march_increment,
+    const miaux_density_grid *grid = NULL);
+miScalar miaux_tracked_shader_occlusion_at_point(
+    miState *state, miVector *start_point, miVector *direction,
+    miScalar total_distance, miTag density_shader,
+    miScalar unit_density, miScalar majorant, miaux_tracking_mode mode,
+    const miaux_density_grid *grid = NULL);
+miScalar miaux_density_grid_empty_until(
+    const miaux_density_grid *grid,
+    miVector *start_point, miVector *direction, miScalar distance);
 miBoolean miaux_point_inside(miVector *p, miVector *min_p, miVector *max_p);
 void miaux_read_volume_block(
     char* filename, 
     int *width, int *height, int *depth, float* block);
+miScalar miaux_voxel_density(
+    miVector *p, miVector *min_p, miVector *max_p,
+    const miaux_brick_volume *volume);
+void miaux_brick_volume_density_grid(
+    miaux_density_grid *grid, const miaux_brick_volume *volume,
+    miVector *min_p, miVector *max_p);
 double miaux_distance(double x1, double y1, double x2, double y2);
 void miaux_divide_color(miColor *result, miColor* color, miScalar f);
 void miaux_from_camera_space(
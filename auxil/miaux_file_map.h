@@ -0,0 +1,18 @@
+/*
+   Read-only file mapping for the binary hair and volume caches
+
+   Pages are read in on first access, so lookups into a large cache only
+   touch the parts of the file they need.
+*/
+
+#ifndef __MIAUX_FILE_MAP_H__
+#define __MIAUX_FILE_MAP_H__
+
+#include <stddef.h>
+
+/* Maps a whole file read-only, returns NULL on failure. sequential hints
+   that the file is read front to back once rather than looked up at random. */
+const void *miaux_map_file(const char *filename, size_t *size, int sequential);
+void miaux_unmap_file(const void *data, size_t size);
+
+#endif
@@ -0,0 +1,121 @@
+/*
+   Binary hair cache for miaux_read_hair_data_file, see miaux_hair_cache.h
+*/
+
+#include "miaux_hair_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+int miaux_read_hair_cache_header(const char *filename, miaux_hair_cache_header *header)
+{
+	FILE *fp = fopen(filename, "rb");
+	if (fp == NULL)
+		return 0;
+
+	int ok = fread(header, sizeof(*header), 1, fp) == 1 &&
+		memcmp(header->magic, MIAUX_HAIR_CACHE_MAGIC, sizeof(MIAUX_HAIR_CACHE_MAGIC)) == 0 &&
+		header->version == MIAUX_HAIR_CACHE_VERSION;
+	fclose(fp);
+	return ok;
+}
+
+int miaux_convert_hair_data_file(const char *text_filename, const char *cache_filename)
+{
+	miaux_hair_cache_header header;
+	FILE *in, *out;
+	float *scalars, *s, age, bbox[6];
+	int32_t *indices, *hi;
+	int hair_count, total_vertex_count, vertex_count, h;
+	size_t scalar_count, remaining, n, v;
+
+	in = fopen(text_filename, "r");
+	if (in == NULL)
+		return 0;
+
+	if (fscanf(in, "%d %d ", &hair_count, &total_vertex_count) != 2 ||
+		fscanf(in, "%f %f %f %f %f %f ", &bbox[0], &bbox[1], &bbox[2], &bbox[3], &bbox[4], &bbox[5]) != 6 ||
+		hair_count < 0 || total_vertex_count < 0) {
+		fclose(in);
+		return 0;
+	}
+
+	/* Offsets into the scalars are stored as int32_t, so the scalar count has to fit one */
+	scalar_count = (size_t)hair_count * 2 + (size_t)total_vertex_count * 3;
+	if (scalar_count > INT32_MAX) {
+		fclose(in);
+		return 0;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MIAUX_HAIR_CACHE_MAGIC, sizeof(MIAUX_HAIR_CACHE_MAGIC));
+	header.version = MIAUX_HAIR_CACHE_VERSION;
+	header.hair_count = (uint32_t)hair_count;
+	header.total_vertex_count = (uint32_t)total_vertex_count;
+	header.scalar_count = (uint32_t)scalar_count;
+	memcpy(header.bbox_min, bbox, sizeof(header.bbox_min));
+	memcpy(header.bbox_max, bbox + 3, sizeof(header.bbox_max));
+
+	s = scalars = (float*)malloc(sizeof(float) * (scalar_count > 0 ? scalar_count : 1));
+	hi = indices = (int32_t*)malloc(sizeof(int32_t) * ((size_t)hair_count + 1));
+	if (scalars == NULL || indices == NULL) {
+		fclose(in);
+		free(scalars);
+		free(indices);
+		return 0;
+	}
+	*hi++ = 0;
+
+	/* Same layout miaux_read_hair_data_file builds, the radius is filled in when reading */
+	for (h = 0; h < hair_count; h++) {
+		remaining = scalar_count - (size_t)(s - scalars);
+		if (fscanf(in, "%f %d ", &age, &vertex_count) != 2 ||
+			vertex_count < 0 || remaining < 2 || (size_t)vertex_count > (remaining - 2) / 3)
+			break;
+		*s++ = 0.f;
+		*s++ = age;
+		n = (size_t)vertex_count * 3;
+		for (v = 0; v < n; v++)
+			if (fscanf(in, "%f ", s++) != 1)
+				break;
+		if (v < n)
+			break;
+		*hi++ = (int32_t)(s - scalars);
+	}
+	fclose(in);
+
+	int ok = h == hair_count && (size_t)(s - scalars) == scalar_count;
+	if (ok) {
+		out = fopen(cache_filename, "wb");
+		ok = out != NULL &&
+			fwrite(&header, sizeof(header), 1, out) == 1 &&
+			fwrite(scalars, sizeof(float), scalar_count, out) == scalar_count &&
+			fwrite(indices, sizeof(int32_t), (size_t)hair_count + 1, out) == (size_t)hair_count + 1;
+		if (out != NULL && fclose(out) != 0)
+			ok = 0;
+	}
+
+	free(scalars);
+	free(indices);
+	return ok;
+}
+
+#ifdef MIAUX_HAIR_CACHE_MAIN
+
+/* Standalone converter, see README.md */
+int main(int argc, char **argv)
+{
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s hair.txt hair.hcache\n", argv[0]);
+		return 2;
+	}
+	if (!miaux_convert_hair_data_file(argv[1], argv[2])) {
+		fprintf(stderr, "could not convert %s\n", argv[1]);
+		return 1;
+	}
+	return 0;
+}
+
+#endif
@@ -0,0 +1,40 @@
+/*
+   Binary hair cache for miaux_read_hair_data_file
+
+   The text hair format is parsed one fscanf per float, the cache stores the
+   same data already laid out as mental ray's hair scalar and index arrays
+   so it can be mapped and copied in one go. Only depends on the C library,
+   so the converter can also be built as a standalone tool.
+
+   Layout (native byte order):
+     miaux_hair_cache_header
+     float   scalars[scalar_count]     per hair: radius (0), age, x y z per vertex
+     int32_t indices[hair_count + 1]   offset of each hair in scalars, then the total
+*/
+
+#ifndef __MIAUX_HAIR_CACHE_H__
+#define __MIAUX_HAIR_CACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MIAUX_HAIR_CACHE_MAGIC "SLHHAIR"
+#define MIAUX_HAIR_CACHE_VERSION 1
+
+typedef struct miaux_hair_cache_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	hair_count;
+	uint32_t	total_vertex_count;
+	uint32_t	scalar_count;		/* hair_count * 2 + total_vertex_count * 3 */
+	float		bbox_min[3];
+	float		bbox_max[3];
+} miaux_hair_cache_header;
+
+/* Reads only the header, returns 0 if filename isn't a hair cache */
+int miaux_read_hair_cache_header(const char *filename, miaux_hair_cache_header *header);
+
+/* Converts a text hair data file to a cache, returns 0 on failure */
+int miaux_convert_hair_data_file(const char *text_filename, const char *cache_filename);
+
+#endif
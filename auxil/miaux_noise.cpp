@@ -0,0 +1,231 @@
+/*
+   Multi-octave gradient noise, see miaux_noise.h
+*/
+
+#include "miaux_noise.h"
+
+#include <math.h>
+
+#if defined(SLH_NO_SIMD)
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIAUX_NOISE_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define MIAUX_NOISE_NEON
+#include <arm_neon.h>
+#endif
+
+
+/* Ken Perlin's reference permutation */
+static const unsigned char perm[256] = {
+	151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7, 225,
+	140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23, 190, 6, 148,
+	247, 120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32,
+	57, 177, 33, 88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175,
+	74, 165, 71, 134, 139, 48, 27, 166, 77, 146, 158, 231, 83, 111, 229, 122,
+	60, 211, 133, 230, 220, 105, 92, 41, 55, 46, 245, 40, 244, 102, 143, 54,
+	65, 25, 63, 161, 1, 216, 80, 73, 209, 76, 132, 187, 208, 89, 18, 169,
+	200, 196, 135, 130, 116, 188, 159, 86, 164, 100, 109, 198, 173, 186, 3, 64,
+	52, 217, 226, 250, 124, 123, 5, 202, 38, 147, 118, 126, 255, 82, 85, 212,
+	207, 206, 59, 227, 47, 16, 58, 17, 182, 189, 28, 42, 223, 183, 170, 213,
+	119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101, 155, 167, 43, 172, 9,
+	129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232, 178, 185, 112, 104,
+	218, 246, 97, 228, 251, 34, 242, 193, 238, 210, 144, 12, 191, 179, 162, 241,
+	81, 51, 145, 235, 249, 14, 239, 107, 49, 192, 214, 31, 181, 199, 106, 157,
+	184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254, 138, 236, 205, 93,
+	222, 114, 67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180,
+};
+
+/* The 12 edge gradients of improved noise, padded to 16 */
+static const float grad[16][3] = {
+	{ 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 },
+	{ 1, 0, 1 }, { -1, 0, 1 }, { 1, 0, -1 }, { -1, 0, -1 },
+	{ 0, 1, 1 }, { 0, -1, 1 }, { 0, 1, -1 }, { 0, -1, -1 },
+	{ 1, 1, 0 }, { 0, -1, 1 }, { -1, 1, 0 }, { 0, -1, -1 },
+};
+
+
+/* Four noise lanes, only the arithmetic the kernel needs */
+#if defined(MIAUX_NOISE_SSE)
+
+struct NoiseVec {
+	__m128 v;
+
+	NoiseVec(__m128 v) : v(v) {}
+	NoiseVec(float s) : v(_mm_set1_ps(s)) {}
+	static NoiseVec Load(const float *p) { return _mm_loadu_ps(p); }
+	void Store(float *p) const { _mm_storeu_ps(p, v); }
+};
+
+inline NoiseVec operator+(NoiseVec A, NoiseVec B) { return _mm_add_ps(A.v, B.v); }
+inline NoiseVec operator-(NoiseVec A, NoiseVec B) { return _mm_sub_ps(A.v, B.v); }
+inline NoiseVec operator*(NoiseVec A, NoiseVec B) { return _mm_mul_ps(A.v, B.v); }
+
+#elif defined(MIAUX_NOISE_NEON)
+
+struct NoiseVec {
+	float32x4_t v;
+
+	NoiseVec(float32x4_t v) : v(v) {}
+	NoiseVec(float s) : v(vdupq_n_f32(s)) {}
+	static NoiseVec Load(const float *p) { return vld1q_f32(p); }
+	void Store(float *p) const { vst1q_f32(p, v); }
+};
+
+inline NoiseVec operator+(NoiseVec A, NoiseVec B) { return vaddq_f32(A.v, B.v); }
+inline NoiseVec operator-(NoiseVec A, NoiseVec B) { return vsubq_f32(A.v, B.v); }
+inline NoiseVec operator*(NoiseVec A, NoiseVec B) { return vmulq_f32(A.v, B.v); }
+
+#else
+
+struct NoiseVec {
+	float v[4];
+
+	NoiseVec() {}
+	NoiseVec(float s) : v{ s, s, s, s } {}
+	static NoiseVec Load(const float *p) { NoiseVec r; for (int i = 0; i < 4; i++) r.v[i] = p[i]; return r; }
+	void Store(float *p) const { for (int i = 0; i < 4; i++) p[i] = v[i]; }
+};
+
+inline NoiseVec operator+(NoiseVec A, NoiseVec B) { for (int i = 0; i < 4; i++) A.v[i] += B.v[i]; return A; }
+inline NoiseVec operator-(NoiseVec A, NoiseVec B) { for (int i = 0; i < 4; i++) A.v[i] -= B.v[i]; return A; }
+inline NoiseVec operator*(NoiseVec A, NoiseVec B) { for (int i = 0; i < 4; i++) A.v[i] *= B.v[i]; return A; }
+
+#endif
+
+inline NoiseVec Fade(NoiseVec t) { return t * t * t * (t * (t * NoiseVec(6.f) - NoiseVec(15.f)) + NoiseVec(10.f)); }
+inline NoiseVec Lerp(NoiseVec t, NoiseVec a, NoiseVec b) { return a + t * (b - a); }
+
+inline float HorizontalSum(NoiseVec A)
+{
+	float lanes[4];
+	A.Store(lanes);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+
+/* Four points of one octave. The lattice hashing is done per lane, the
+   fade, gradient dot products and trilinear blend run on all four at once. */
+static NoiseVec gradient_noise4(const float *x, const float *y, const float *z)
+{
+	float fx[4], fy[4], fz[4], gx[8][4], gy[8][4], gz[8][4];
+
+	for (int lane = 0; lane < 4; lane++) {
+		float flx = floorf(x[lane]), fly = floorf(y[lane]), flz = floorf(z[lane]);
+		int X = (int)flx & 255, Y = (int)fly & 255, Z = (int)flz & 255;
+		fx[lane] = x[lane] - flx;
+		fy[lane] = y[lane] - fly;
+		fz[lane] = z[lane] - flz;
+
+		int A = (perm[X] + Y) & 255, B = (perm[(X + 1) & 255] + Y) & 255;
+		int AA = (perm[A] + Z) & 255, AB = (perm[(A + 1) & 255] + Z) & 255;
+		int BA = (perm[B] + Z) & 255, BB = (perm[(B + 1) & 255] + Z) & 255;
+
+		/* Corner c is offset by (c & 1, c >> 1 & 1, c >> 2) */
+		const int hash[8] = {
+			perm[AA], perm[BA], perm[AB], perm[BB],
+			perm[(AA + 1) & 255], perm[(BA + 1) & 255], perm[(AB + 1) & 255], perm[(BB + 1) & 255]
+		};
+		for (int c = 0; c < 8; c++) {
+			const float *g = grad[hash[c] & 15];
+			gx[c][lane] = g[0];
+			gy[c][lane] = g[1];
+			gz[c][lane] = g[2];
+		}
+	}
+
+	NoiseVec X0 = NoiseVec::Load(fx), Y0 = NoiseVec::Load(fy), Z0 = NoiseVec::Load(fz);
+	NoiseVec X1 = X0 - NoiseVec(1.f), Y1 = Y0 - NoiseVec(1.f), Z1 = Z0 - NoiseVec(1.f);
+
+	NoiseVec d[8] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
+	for (int c = 0; c < 8; c++)
+		d[c] = NoiseVec::Load(gx[c]) * (c & 1 ? X1 : X0) +
+			NoiseVec::Load(gy[c]) * (c & 2 ? Y1 : Y0) +
+			NoiseVec::Load(gz[c]) * (c & 4 ? Z1 : Z0);
+
+	NoiseVec u = Fade(X0), v = Fade(Y0), w = Fade(Z0);
+	NoiseVec n = Lerp(w,
+		Lerp(v, Lerp(u, d[0], d[1]), Lerp(u, d[2], d[3])),
+		Lerp(v, Lerp(u, d[4], d[5]), Lerp(u, d[6], d[7])));
+
+	return NoiseVec(0.5f) + NoiseVec(0.5f) * n;
+}
+
+float miaux_gradient_noise(float x, float y, float z)
+{
+	float px[4] = { x }, py[4] = { y }, pz[4] = { z }, result[4];
+	gradient_noise4(px, py, pz).Store(result);
+	return result[0];
+}
+
+/* The lanes hold four octaves of the one point */
+float miaux_noise_octaves(float x, float y, float z,
+	float summing_weight, float octave_scaling, int octave_count)
+{
+	float px[4], py[4], pz[4], weight[4];
+	float scale = 1.f, noise_scale = 1.f;
+	NoiseVec sum(0.f), maximum_sum(0.f);
+
+	if (octave_count <= 0)
+		return 0.f;
+
+	for (int i = 0; i < octave_count; i += 4) {
+		for (int lane = 0; lane < 4; lane++) {
+			if (i + lane < octave_count) {
+				px[lane] = x * scale;
+				py[lane] = y * scale;
+				pz[lane] = z * scale;
+				weight[lane] = 1.f / noise_scale;
+				scale *= octave_scaling;
+				noise_scale *= summing_weight;
+			}
+			else
+				px[lane] = py[lane] = pz[lane] = weight[lane] = 0.f;
+		}
+		NoiseVec w = NoiseVec::Load(weight);
+		sum = sum + gradient_noise4(px, py, pz) * w;
+		maximum_sum = maximum_sum + w;
+	}
+	return HorizontalSum(sum) / HorizontalSum(maximum_sum);
+}
+
+/* The lanes hold four points of the one octave */
+void miaux_noise_octaves_batch(float *result, const float *points, int count,
+	float summing_weight, float octave_scaling, int octave_count)
+{
+	float px[4], py[4], pz[4], scaled_x[4], scaled_y[4], scaled_z[4];
+	float maximum_sum = 0.f, noise_scale = 1.f;
+
+	for (int i = 0; i < octave_count; i++, noise_scale *= summing_weight)
+		maximum_sum += 1.f / noise_scale;
+	NoiseVec normalize(maximum_sum > 0.f ? 1.f / maximum_sum : 0.f);
+
+	for (int p = 0; p < count; p += 4) {
+		int lanes = count - p < 4 ? count - p : 4;
+		for (int lane = 0; lane < 4; lane++) {
+			const float *point = points + 3 * (p + (lane < lanes ? lane : 0));
+			px[lane] = point[0];
+			py[lane] = point[1];
+			pz[lane] = point[2];
+		}
+
+		NoiseVec sum(0.f);
+		float scale = 1.f;
+		noise_scale = 1.f;
+		for (int i = 0; i < octave_count; i++) {
+			for (int lane = 0; lane < 4; lane++) {
+				scaled_x[lane] = px[lane] * scale;
+				scaled_y[lane] = py[lane] * scale;
+				scaled_z[lane] = pz[lane] * scale;
+			}
+			sum = sum + gradient_noise4(scaled_x, scaled_y, scaled_z) * NoiseVec(1.f / noise_scale);
+			scale *= octave_scaling;
+			noise_scale *= summing_weight;
+		}
+
+		float lane_result[4];
+		(sum * normalize).Store(lane_result);
+		for (int lane = 0; lane < lanes; lane++)
+			result[p + lane] = lane_result[lane];
+	}
+}
@@ -0,0 +1,24 @@
+/*
+   Multi-octave gradient noise for miaux_gradient_summed_noise
+
+   Improved Perlin noise evaluated four lanes at a time, across octaves for
+   a single point and across points for the batched version. Values are in
+   [0, 1] like mi_unoise_3d. SLH_NO_SIMD builds the plain four float lanes.
+*/
+
+#ifndef __MIAUX_NOISE_H__
+#define __MIAUX_NOISE_H__
+
+/* One octave of gradient noise */
+float miaux_gradient_noise(float x, float y, float z);
+
+/* Octave i is taken at the point scaled by octave_scaling^i and weighted
+   by summing_weight^-i, the sum is normalized back to [0, 1] */
+float miaux_noise_octaves(float x, float y, float z,
+	float summing_weight, float octave_scaling, int octave_count);
+
+/* Same for count points stored as consecutive x, y, z triples */
+void miaux_noise_octaves_batch(float *result, const float *points, int count,
+	float summing_weight, float octave_scaling, int octave_count);
+
+#endif
@@ -0,0 +1,230 @@
+/*
+   Sparse brick volume format, see miaux_volume_bricks.h
+*/
+
+#include "miaux_volume_bricks.h"
+#include "miaux_file_map.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define miaux_fseek _fseeki64
+#define miaux_ftell _ftelli64
+#else
+#define miaux_fseek fseeko
+#define miaux_ftell ftello
+#endif
+
+#define MIAUX_BRICKS_ALIGNMENT 4096
+
+
+/* Brick counts per axis, 0 if a dimension is out of range */
+static uint32_t miaux_bricks_along(uint32_t voxels)
+{
+	if (voxels == 0 || voxels > INT32_MAX)
+		return 0;
+	return (voxels + MIAUX_BRICK_SIZE - 1) >> MIAUX_BRICK_SHIFT;
+}
+
+/* The lookups index the mapping straight from the header and slots, so every one is checked */
+static int miaux_valid_brick_volume(const miaux_volume_bricks_header *header, size_t size)
+{
+	const int32_t *slots;
+	size_t cell_count, c;
+
+	if (header->bricks_x == 0 || header->bricks_x != miaux_bricks_along(header->width) ||
+		header->bricks_y == 0 || header->bricks_y != miaux_bricks_along(header->height) ||
+		header->bricks_z == 0 || header->bricks_z != miaux_bricks_along(header->depth) ||
+		header->brick_count > INT32_MAX)
+		return 0;
+
+	/* Cells are numbered with int by miaux_brick_volume_cell */
+	cell_count = (size_t)header->bricks_x * header->bricks_y;
+	if (cell_count > INT32_MAX / header->bricks_z)
+		return 0;
+	cell_count *= header->bricks_z;
+
+	if (header->bricks_offset % sizeof(float) != 0 ||
+		header->bricks_offset < sizeof(*header) + cell_count * (sizeof(int32_t) + sizeof(float)) ||
+		header->bricks_offset > size ||
+		header->brick_count > (size - header->bricks_offset) / (MIAUX_BRICK_VOXELS * sizeof(float)))
+		return 0;
+
+	slots = (const int32_t*)(header + 1);
+	for (c = 0; c < cell_count; c++)
+		if (slots[c] != -1 && (slots[c] < 0 || (uint32_t)slots[c] >= header->brick_count))
+			return 0;
+	return 1;
+}
+
+int miaux_open_brick_volume(const char *filename, miaux_brick_volume *volume)
+{
+	const miaux_volume_bricks_header *header;
+	const char *data;
+	size_t size, cell_count;
+
+	memset(volume, 0, sizeof(*volume));
+	data = (const char*)miaux_map_file(filename, &size, 0);
+	if (data == NULL)
+		return 0;
+
+	header = (const miaux_volume_bricks_header*)data;
+	if (size < sizeof(*header) ||
+		memcmp(header->magic, MIAUX_VOLUME_BRICKS_MAGIC, sizeof(MIAUX_VOLUME_BRICKS_MAGIC)) != 0 ||
+		header->version != MIAUX_VOLUME_BRICKS_VERSION) {
+		miaux_unmap_file(data, size);
+		return 0;
+	}
+
+	if (!miaux_valid_brick_volume(header, size)) {
+		miaux_unmap_file(data, size);
+		return -1;
+	}
+
+	cell_count = (size_t)header->bricks_x * header->bricks_y * header->bricks_z;
+	volume->header = header;
+	volume->slots = (const int32_t*)(header + 1);
+	volume->max_density = (const float*)(volume->slots + cell_count);
+	volume->bricks = (const float*)(data + header->bricks_offset);
+	volume->size = size;
+	return 1;
+}
+
+void miaux_close_brick_volume(miaux_brick_volume *volume)
+{
+	if (volume->header != NULL)
+		miaux_unmap_file(volume->header, volume->size);
+	memset(volume, 0, sizeof(*volume));
+}
+
+/* Only 8 slices of the dense volume are held at a time */
+int miaux_convert_volume_block_file(const char *block_filename, const char *bricks_filename)
+{
+	miaux_volume_bricks_header header;
+	FILE *in, *out;
+	int width, height, depth, bx, by, bz, x, y, z;
+	int32_t *slots;
+	float *max_density, *slab, brick[MIAUX_BRICK_VOXELS];
+	size_t cell_count, slab_size, count;
+
+	in = fopen(block_filename, "rb");
+	if (in == NULL)
+		return 0;
+	if (fscanf(in, "%d %d %d", &width, &height, &depth) != 3 ||
+		width <= 0 || height <= 0 || depth <= 0) {
+		fclose(in);
+		return 0;
+	}
+
+	/* The floats end the file, the text line may be followed by any whitespace */
+	count = (size_t)width * height * depth;
+	if (miaux_fseek(in, 0, SEEK_END) != 0 ||
+		(size_t)miaux_ftell(in) < count * sizeof(float) ||
+		miaux_fseek(in, miaux_ftell(in) - (long long)(count * sizeof(float)), SEEK_SET) != 0) {
+		fclose(in);
+		return 0;
+	}
+
+	out = fopen(bricks_filename, "wb");
+	if (out == NULL) {
+		fclose(in);
+		return 0;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MIAUX_VOLUME_BRICKS_MAGIC, sizeof(MIAUX_VOLUME_BRICKS_MAGIC));
+	header.version = MIAUX_VOLUME_BRICKS_VERSION;
+	header.width = width;
+	header.height = height;
+	header.depth = depth;
+	header.bricks_x = (width + MIAUX_BRICK_SIZE - 1) >> MIAUX_BRICK_SHIFT;
+	header.bricks_y = (height + MIAUX_BRICK_SIZE - 1) >> MIAUX_BRICK_SHIFT;
+	header.bricks_z = (depth + MIAUX_BRICK_SIZE - 1) >> MIAUX_BRICK_SHIFT;
+	cell_count = (size_t)header.bricks_x * header.bricks_y * header.bricks_z;
+	header.bricks_offset = (sizeof(header) + cell_count * (sizeof(int32_t) + sizeof(float)) +
+		MIAUX_BRICKS_ALIGNMENT - 1) & ~(uint64_t)(MIAUX_BRICKS_ALIGNMENT - 1);
+
+	slots = (int32_t*)malloc(sizeof(int32_t) * cell_count);
+	max_density = (float*)malloc(sizeof(float) * cell_count);
+	slab_size = (size_t)width * height * MIAUX_BRICK_SIZE;
+	slab = (float*)malloc(sizeof(float) * slab_size);
+
+	int ok = slots != NULL && max_density != NULL && slab != NULL &&
+		miaux_fseek(out, header.bricks_offset, SEEK_SET) == 0;
+
+	for (bz = 0; ok && bz < (int)header.bricks_z; bz++) {
+		int z0 = bz << MIAUX_BRICK_SHIFT;
+		int slices = depth - z0 < MIAUX_BRICK_SIZE ? depth - z0 : MIAUX_BRICK_SIZE;
+		size_t slice_size = (size_t)width * height;
+		if (fread(slab, sizeof(float), slice_size * slices, in) != slice_size * slices) {
+			ok = 0;
+			break;
+		}
+
+		for (by = 0; by < (int)header.bricks_y; by++) {
+			for (bx = 0; bx < (int)header.bricks_x; bx++) {
+				int x0 = bx << MIAUX_BRICK_SHIFT, y0 = by << MIAUX_BRICK_SHIFT;
+				int occupied = 0;
+				float brick_max = 0.f;
+
+				/* Voxels past the edge of the volume are padded with 0 */
+				float *b = brick;
+				for (z = 0; z < MIAUX_BRICK_SIZE; z++)
+					for (y = 0; y < MIAUX_BRICK_SIZE; y++)
+						for (x = 0; x < MIAUX_BRICK_SIZE; x++, b++) {
+							*b = z < slices && y0 + y < height && x0 + x < width ?
+								slab[slice_size * z + (size_t)width * (y0 + y) + x0 + x] : 0.f;
+							if (*b != 0.f)
+								occupied = 1;
+							if (*b > brick_max)
+								brick_max = *b;
+						}
+
+				size_t c = ((size_t)header.bricks_y * bz + by) * header.bricks_x + bx;
+				if (occupied) {
+					slots[c] = header.brick_count++;
+					if (fwrite(brick, sizeof(float), MIAUX_BRICK_VOXELS, out) != MIAUX_BRICK_VOXELS)
+						ok = 0;
+				}
+				else
+					slots[c] = -1;
+				max_density[c] = brick_max;
+				if (brick_max > header.max_density)
+					header.max_density = brick_max;
+			}
+		}
+	}
+	fclose(in);
+
+	ok = ok && miaux_fseek(out, 0, SEEK_SET) == 0 &&
+		fwrite(&header, sizeof(header), 1, out) == 1 &&
+		fwrite(slots, sizeof(int32_t), cell_count, out) == cell_count &&
+		fwrite(max_density, sizeof(float), cell_count, out) == cell_count;
+	if (fclose(out) != 0)
+		ok = 0;
+
+	free(slots);
+	free(max_density);
+	free(slab);
+	return ok;
+}
+
+#ifdef MIAUX_VOLUME_BRICKS_MAIN
+
+/* Standalone converter, see README.md */
+int main(int argc, char **argv)
+{
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s volume.vol volume.bricks\n", argv[0]);
+		return 2;
+	}
+	if (!miaux_convert_volume_block_file(argv[1], argv[2])) {
+		fprintf(stderr, "could not convert %s\n", argv[1]);
+		return 1;
+	}
+	return 0;
+}
+
+#endif
@@ -0,0 +1,77 @@
+/*
+   Sparse brick volume format for the voxel_density shader
+
+   The dense format read by miaux_read_volume_block is a "width height depth"
+   text line followed by width * height * depth raw floats, x varying
+   fastest. Most of a simulation cache is empty, so the brick format splits
+   the grid into 8x8x8 bricks and only stores the bricks that hold a
+   non-zero voxel. The file is mapped, so a lookup only pages in the brick
+   it lands in and memory scales with the occupied voxels actually touched.
+
+   Layout (native byte order):
+     miaux_volume_bricks_header
+     int32_t slots[cell_count]        brick index in bricks, -1 if empty
+     float   max_density[cell_count]  largest voxel of each brick, 0 if empty
+     float   bricks[brick_count][512] at bricks_offset, page aligned
+   where cell_count = bricks_x * bricks_y * bricks_z, again x fastest.
+*/
+
+#ifndef __MIAUX_VOLUME_BRICKS_H__
+#define __MIAUX_VOLUME_BRICKS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MIAUX_VOLUME_BRICKS_MAGIC "SLHVOLB"
+#define MIAUX_VOLUME_BRICKS_VERSION 1
+#define MIAUX_BRICK_SHIFT 3
+#define MIAUX_BRICK_SIZE (1 << MIAUX_BRICK_SHIFT)
+#define MIAUX_BRICK_VOXELS (MIAUX_BRICK_SIZE * MIAUX_BRICK_SIZE * MIAUX_BRICK_SIZE)
+
+typedef struct miaux_volume_bricks_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	width, height, depth;
+	uint32_t	bricks_x, bricks_y, bricks_z;
+	uint32_t	brick_count;		/* occupied bricks stored in the file */
+	uint64_t	bricks_offset;
+	float		max_density;		/* largest voxel in the volume */
+	uint32_t	reserved;
+} miaux_volume_bricks_header;
+
+typedef struct miaux_brick_volume {
+	const miaux_volume_bricks_header *header;
+	const int32_t *slots;
+	const float *max_density;
+	const float *bricks;
+	size_t size;
+} miaux_brick_volume;
+
+/* Maps a brick volume, returns 0 if filename isn't one and -1 if it is but is truncated or
+   its header and brick slots don't agree */
+int miaux_open_brick_volume(const char *filename, miaux_brick_volume *volume);
+void miaux_close_brick_volume(miaux_brick_volume *volume);
+
+/* Converts a dense volume block file to bricks, returns 0 on failure */
+int miaux_convert_volume_block_file(const char *block_filename, const char *bricks_filename);
+
+inline int miaux_brick_volume_cell(const miaux_brick_volume *volume, int bx, int by, int bz)
+{
+	const miaux_volume_bricks_header *h = volume->header;
+	return ((int)h->bricks_y * bz + by) * (int)h->bricks_x + bx;
+}
+
+/* Voxel lookup, x, y and z must be inside the volume */
+inline float miaux_brick_volume_voxel(const miaux_brick_volume *volume, int x, int y, int z)
+{
+	int32_t slot = volume->slots[miaux_brick_volume_cell(volume,
+		x >> MIAUX_BRICK_SHIFT, y >> MIAUX_BRICK_SHIFT, z >> MIAUX_BRICK_SHIFT)];
+	if (slot < 0)
+		return 0.f;
+
+	const int mask = MIAUX_BRICK_SIZE - 1;
+	return volume->bricks[(size_t)slot * MIAUX_BRICK_VOXELS +
+		(((z & mask) << MIAUX_BRICK_SHIFT | (y & mask)) << MIAUX_BRICK_SHIFT | (x & mask))];
+}
+
+#endif
@@ -4,14 +4,106 @@
 #include "shader.h"
 #include "stringprint.h"
 #include <string>
+#include <cstddef>
+#include <cmath>
+#include <iostream>
+
+//
+// 4-wide colour register used to implement the arithmetic operators below.
+// miColor is four contiguous floats (r, g, b, a), so it is loaded and stored
+// directly; the operators keep returning alpha = 1 as before. Define
+// SLH_NO_SIMD to build the scalar fallback, bench/ compares the two.
+//
+#if defined(SLH_NO_SIMD)
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SLH_COLOR_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define SLH_COLOR_NEON
+#include <arm_neon.h>
+#endif
+
+static_assert(sizeof(miColor) == 4 * sizeof(miScalar), "miColor must be four packed floats");
+static_assert(offsetof(miColor, a) == 3 * sizeof(miScalar), "miColor must be laid out r, g, b, a");
+
+#if defined(SLH_COLOR_SSE)
+
+struct ColorVec {
+	__m128 v;
+
+	ColorVec(__m128 v) : v(v) {}
+	explicit ColorVec(const miColor& A) : v(_mm_loadu_ps(&A.r)) {}
+	explicit ColorVec(miScalar s) : v(_mm_set1_ps(s)) {}
+
+	// alpha goes into the register first, storing it over the vector store
+	// would stall the next operator's load of the result
+	miColor ToColor(miScalar alpha = 1.f) const {
+		miColor ret;
+		__m128 ba = _mm_unpackhi_ps(v, _mm_set1_ps(alpha));
+		_mm_storeu_ps(&ret.r, _mm_shuffle_ps(v, ba, _MM_SHUFFLE(1, 0, 1, 0)));
+		return ret;
+	}
+};
+
+inline ColorVec operator+(ColorVec A, ColorVec B) { return _mm_add_ps(A.v, B.v); }
+inline ColorVec operator-(ColorVec A, ColorVec B) { return _mm_sub_ps(A.v, B.v); }
+inline ColorVec operator*(ColorVec A, ColorVec B) { return _mm_mul_ps(A.v, B.v); }
+inline ColorVec operator/(ColorVec A, ColorVec B) { return _mm_div_ps(A.v, B.v); }
+inline ColorVec Sqrt(ColorVec A) { return _mm_sqrt_ps(A.v); }
+inline ColorVec Abs(ColorVec A) { return _mm_and_ps(A.v, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff))); }
+
+#elif defined(SLH_COLOR_NEON)
+
+struct ColorVec {
+	float32x4_t v;
+
+	ColorVec(float32x4_t v) : v(v) {}
+	explicit ColorVec(const miColor& A) : v(vld1q_f32(&A.r)) {}
+	explicit ColorVec(miScalar s) : v(vdupq_n_f32(s)) {}
+
+	miColor ToColor(miScalar alpha = 1.f) const {
+		miColor ret;
+		vst1q_f32(&ret.r, vsetq_lane_f32(alpha, v, 3));
+		return ret;
+	}
+};
+
+inline ColorVec operator+(ColorVec A, ColorVec B) { return vaddq_f32(A.v, B.v); }
+inline ColorVec operator-(ColorVec A, ColorVec B) { return vsubq_f32(A.v, B.v); }
+inline ColorVec operator*(ColorVec A, ColorVec B) { return vmulq_f32(A.v, B.v); }
+inline ColorVec operator/(ColorVec A, ColorVec B) { return vdivq_f32(A.v, B.v); }
+inline ColorVec Sqrt(ColorVec A) { return vsqrtq_f32(A.v); }
+inline ColorVec Abs(ColorVec A) { return vabsq_f32(A.v); }
+
+#else
+
+struct ColorVec {
+	miScalar v[4];
+
+	explicit ColorVec(const miColor& A) : v{ A.r, A.g, A.b, A.a } {}
+	explicit ColorVec(miScalar s) : v{ s, s, s, s } {}
+	ColorVec(miScalar r, miScalar g, miScalar b, miScalar a) : v{ r, g, b, a } {}
+
+	miColor ToColor(miScalar alpha = 1.f) const { return { v[0], v[1], v[2], alpha }; }
+};
+
+inline ColorVec operator+(ColorVec A, ColorVec B) { return { A.v[0] + B.v[0], A.v[1] + B.v[1], A.v[2] + B.v[2], A.v[3] + B.v[3] }; }
+inline ColorVec operator-(ColorVec A, ColorVec B) { return { A.v[0] - B.v[0], A.v[1] - B.v[1], A.v[2] - B.v[2], A.v[3] - B.v[3] }; }
+inline ColorVec operator*(ColorVec A, ColorVec B) { return { A.v[0] * B.v[0], A.v[1] * B.v[1], A.v[2] * B.v[2], A.v[3] * B.v[3] }; }
+inline ColorVec operator/(ColorVec A, ColorVec B) { return { A.v[0] / B.v[0], A.v[1] / B.v[1], A.v[2] / B.v[2], A.v[3] / B.v[3] }; }
+inline ColorVec Sqrt(ColorVec A) { return { std::sqrt(A.v[0]), std::sqrt(A.v[1]), std::sqrt(A.v[2]), std::sqrt(A.v[3]) }; }
+inline ColorVec Abs(ColorVec A) { return { std::abs(A.v[0]), std::abs(A.v[1]), std::abs(A.v[2]), std::abs(A.v[3]) }; }
+
+#endif
+
 
 //misc PBRT based ops
 inline miColor Sqrt(const miColor& A) {
-	return { std::sqrt(A.r), std::sqrt(A.g),  std::sqrt(A.b), 1.0 };
+	return Sqrt(ColorVec(A)).ToColor();
 }
 
 inline miColor Abs(const miColor& A) {
-	return { std::abs(A.r), std::abs(A.g),  std::abs(A.b), 1.0 };
+	return Abs(ColorVec(A)).ToColor();
 }
 
 inline std::string MiToString(const miColor& A) {
@@ -19,42 +111,42 @@ inline std::string MiToString(const miColor& A) {
 }
 
 inline bool HasNan(const miColor& A) {
-	return isnan(A.r) || isnan(A.g) || isnan(A.b);
+	return std::isnan(A.r) || std::isnan(A.g) || std::isnan(A.b);
 }
 
 
 // miColor x miColor
 inline miColor operator+(const miColor& A, const miColor& B) {
-	return { A.r + B.r, A.g + B.g, A.b + B.b, 1.f };
+	return (ColorVec(A) + ColorVec(B)).ToColor();
 }
 
 inline miColor operator-(const miColor& A, const miColor& B) {
-	return { A.r - B.r, A.g - B.g, A.b - B.b, 1.f };
+	return (ColorVec(A) - ColorVec(B)).ToColor();
 }
 
 inline miColor operator*(const miColor& A, const miColor& B) {
-	return { A.r * B.r, A.g * B.g, A.b * B.b, 1.f };
+	return (ColorVec(A) * ColorVec(B)).ToColor();
 }
 
 inline miColor operator/(const miColor& A, const miColor& B) {
-	return { A.r / B.r, A.g / B.g, A.b / B.b, 1.f };
+	return (ColorVec(A) / ColorVec(B)).ToColor();
 }
 
 
 // templates
 template <typename T>
 inline miColor operator+(const miColor& A, const T B) {
-	return { A.r + B, A.g + B, A.b + B, 1.f };
+	return (ColorVec(A) + ColorVec((miScalar)B)).ToColor();
 }
 
 template <typename T>
 inline miColor operator-(const miColor& A, const T B) {
-	return { A.r - B, A.g - B, A.b - B, 1.f };
+	return (ColorVec(A) - ColorVec((miScalar)B)).ToColor();
 }
 
 template <typename T>
 inline miColor operator*(const miColor& A, const T B) {
-	return { A.r * B, A.g * B, A.b * B, 1.f };
+	return (ColorVec(A) * ColorVec((miScalar)B)).ToColor();
 }
 
 template <typename T>
@@ -70,7 +162,7 @@ inline miColor operator+(T B, const miColor& A) {
 
 template <typename T>
 inline miColor operator-(T B, const miColor& A) {
-	return { B - A.r, B - A.g, B - A.b, 1. };
+	return (ColorVec((miScalar)B) - ColorVec(A)).ToColor();
 }
 
 template <typename T>
@@ -80,74 +172,51 @@ inline miColor operator*(T B, const miColor& A) {
 
 template <typename T>
 inline miColor operator/(miScalar B, const miColor& A) {
-	return { B / A.r, B / A.g, B / A.b, 1. };
+	return (ColorVec(B) / ColorVec(A)).ToColor();
 }
 
 
 // miColor x= miColor
 inline miColor& operator+=(miColor& A, const miColor B) {
-	A.r += B.r;
-	A.g += B.g;
-	A.b += B.b;
-
+	A = (ColorVec(A) + ColorVec(B)).ToColor(A.a);
 	return A;
 }
 
 inline miColor& operator-=(miColor& A, const miColor B) {
-	A.r -= B.r;
-	A.g -= B.g;
-	A.b -= B.b;
-
+	A = (ColorVec(A) - ColorVec(B)).ToColor(A.a);
 	return A;
 }
 
 inline miColor& operator*=(miColor& A, const miColor B) {
-	A.r *= B.r;
-	A.g *= B.g;
-	A.b *= B.b;
-
+	A = (ColorVec(A) * ColorVec(B)).ToColor(A.a);
 	return A;
 }
 
 inline miColor& operator/=(miColor& A, const miColor B) {
-	A.r /= B.r;
-	A.g /= B.g;
-	A.b /= B.b;
-
+	A = (ColorVec(A) / ColorVec(B)).ToColor(A.a);
 	return A;
 }
 
 
 // miColor x= miScalar
 inline miColor& operator+=(miColor& A, miScalar B) {
-	A.r += B;
-	A.g += B;
-	A.b += B;
-
+	A = (ColorVec(A) + ColorVec(B)).ToColor(A.a);
 	return A;
 }
 
 inline miColor& operator-=(miColor& A, miScalar B) {
-	A.r -= B;
-	A.g -= B;
-	A.b -= B;
-
+	A = (ColorVec(A) - ColorVec(B)).ToColor(A.a);
 	return A;
 }
 
 inline miColor& operator*=(miColor& A, miScalar B) {
-	A.r *= B;
-	A.g *= B;
-	A.b *= B;
-
+	A = (ColorVec(A) * ColorVec(B)).ToColor(A.a);
 	return A;
 }
 
 inline miColor& operator/=(miColor& A, miScalar B) {
 	miScalar inv = 1.f / B;
 	return A *= inv;
-
-	return A;
 }
 
 // equality
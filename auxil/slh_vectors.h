@@ -3,6 +3,8 @@
 
 #include "shader.h"
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 // Operators
 inline miVector operator-(const miVector& A) { return { -A.x, -A.y, -A.z }; }
@@ -41,14 +43,14 @@ inline miScalar Dot(const miVector& A, const miVector& B) {
 }
 
 inline miScalar Magnitude(const miVector& A) {
-	return sqrt((A.x*A.x) + (A.y*A.y) + (A.z*A.z));
+	return std::sqrt((A.x*A.x) + (A.y*A.y) + (A.z*A.z));
 }
 inline miVector Normalize(const miVector& A) {
 	return A / Magnitude(A);
 }
 
 inline miScalar AbsDot(const miVector& A, const miVector& B) {
-	return fabs(Dot(A, B));
+	return std::abs(Dot(A, B));
 }
 
 inline miVector Cross(const miVector& A, const miVector& B) {
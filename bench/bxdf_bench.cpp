@@ -0,0 +1,282 @@
+// Times Sample_f, Sample_f_batch, f and Pdf of the BxDFs in
+// pbrt/core/reflection.h over a sweep of roughness, eta and incident angle and
+// prints the results as JSON. The microfacet lobes are timed both as the
+// polymorphic classes and as the templated ones over TrowbridgeReitz.
+// Samples and directions come from the fixed-seed RNG of core/rng.h, so runs
+// see the same inputs and the checksums only change when the results do.
+//
+//     bxdf_bench [--calls n] [--filter text]
+
+#include "reflection.h"
+#include "microfacet.h"
+#include "sampling.h"
+#include "rng.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace pbrt;
+
+enum LobeKind {
+	SPECULAR_REFLECTION,
+	SPECULAR_TRANSMISSION,
+	FRESNEL_SPECULAR,
+	LAMBERTIAN_REFLECTION,
+	OREN_NAYAR,
+	MICROFACET_REFLECTION,
+	MICROFACET_TRANSMISSION,
+	MICROFACET_REFLECTION_T,
+	MICROFACET_TRANSMISSION_T,
+	FRESNEL_MICROFACET_T,
+	FRESNEL_BLEND,
+	FOURIER_BSDF,
+	LOBE_COUNT
+};
+
+// Parameters each lobe is swept over
+enum { SWEEP_ROUGHNESS = 1, SWEEP_ETA = 2 };
+
+static const struct {
+	const char	*name;
+	int			sweep;
+} LOBES[LOBE_COUNT] = {
+	{ "SpecularReflection",		SWEEP_ETA },
+	{ "SpecularTransmission",	SWEEP_ETA },
+	{ "FresnelSpecular",		SWEEP_ETA },
+	{ "LambertianReflection",	0 },
+	{ "OrenNayar",				SWEEP_ROUGHNESS },
+	{ "MicrofacetReflection",	SWEEP_ROUGHNESS | SWEEP_ETA },
+	{ "MicrofacetTransmission",	SWEEP_ROUGHNESS | SWEEP_ETA },
+	{ "MicrofacetReflectionT",	SWEEP_ROUGHNESS | SWEEP_ETA },
+	{ "MicrofacetTransmissionT",	SWEEP_ROUGHNESS | SWEEP_ETA },
+	{ "FresnelMicrofacetT",		SWEEP_ROUGHNESS | SWEEP_ETA },
+	{ "FresnelBlend",			SWEEP_ROUGHNESS },
+	{ "FourierBSDF",			0 },
+};
+
+static const Float ROUGHNESS[] = { 0.05f, 0.2f, 0.5f };
+static const Float ETA[] = { 1.33f, 1.5f, 2.4f };
+static const Float THETA_DEGREES[] = { 0.f, 30.f, 60.f, 85.f };
+
+static const miColor WHITE = { 1.f, 1.f, 1.f, 1.f };
+static const miColor GREY = { 0.5f, 0.5f, 0.5f, 1.f };
+static const miColor SPECULAR = { 0.04f, 0.04f, 0.04f, 1.f };
+
+// A small single channel table, a constant term and two cosine terms that
+// vary with the zenith angles, with the cdf of the constant term over mu
+struct SyntheticFourierTable : FourierBSDFTable {
+	static const int N_MU = 16, M_MAX = 3;
+	Float muData[N_MU], aData[N_MU * N_MU * M_MAX], a0Data[N_MU * N_MU], cdfData[N_MU * N_MU], recipData[M_MAX];
+	int mData[N_MU * N_MU], offsetData[N_MU * N_MU];
+
+	SyntheticFourierTable() {
+		eta = 1.5f;
+		mMax = M_MAX;
+		nChannels = 1;
+		nMu = N_MU;
+		mu = muData;
+		m = mData;
+		aOffset = offsetData;
+		a = aData;
+		a0 = a0Data;
+		cdf = cdfData;
+		recip = recipData;
+
+		for (int i = 0; i < N_MU; i++)
+			muData[i] = -1.f + 2.f * i / (N_MU - 1);
+		for (int k = 0; k < M_MAX; k++)
+			recipData[k] = k > 0 ? 1.f / k : 0.f;
+		for (int o = 0; o < N_MU; o++) {
+			for (int i = 0; i < N_MU; i++) {
+				int n = o * N_MU + i;
+				mData[n] = M_MAX;
+				offsetData[n] = n * M_MAX;
+				aData[n * M_MAX] = a0Data[n] = 0.25f;
+				aData[n * M_MAX + 1] = 0.075f * (1.f + muData[i] * muData[o]);
+				aData[n * M_MAX + 2] = 0.05f;
+				cdfData[n] = 0.25f * (muData[i] - muData[0]);
+			}
+		}
+	}
+};
+
+struct Lobe {
+	std::unique_ptr<MicrofacetDistribution> distribution;
+	std::unique_ptr<Fresnel> fresnel;
+	std::unique_ptr<BxDF> bxdf;
+};
+
+static void MakeLobe(int kind, Float roughness, Float eta, const FourierBSDFTable &table, Lobe *lobe)
+{
+	Float alpha = TrowbridgeReitzDistribution::RoughnessToAlpha(roughness);
+	lobe->distribution.reset(new TrowbridgeReitzDistribution(alpha, alpha));
+	lobe->fresnel.reset(new FresnelDielectric(1.f, eta));
+
+	switch (kind) {
+	case SPECULAR_REFLECTION:
+		lobe->bxdf.reset(new SpecularReflection(WHITE, lobe->fresnel.get()));
+		break;
+	case SPECULAR_TRANSMISSION:
+		lobe->bxdf.reset(new SpecularTransmission(WHITE, 1.f, eta, TransportMode::Radiance));
+		break;
+	case FRESNEL_SPECULAR:
+		lobe->bxdf.reset(new FresnelSpecular(WHITE, WHITE, 1.f, eta, TransportMode::Radiance));
+		break;
+	case LAMBERTIAN_REFLECTION:
+		lobe->bxdf.reset(new LambertianReflection(GREY));
+		break;
+	case OREN_NAYAR:
+		// sigma in degrees
+		lobe->bxdf.reset(new OrenNayar(GREY, 90.f * roughness));
+		break;
+	case MICROFACET_REFLECTION:
+		lobe->bxdf.reset(new MicrofacetReflection(WHITE, lobe->distribution.get(), lobe->fresnel.get()));
+		break;
+	case MICROFACET_TRANSMISSION:
+		lobe->bxdf.reset(new MicrofacetTransmission(WHITE, lobe->distribution.get(), 1.f, eta, TransportMode::Radiance));
+		break;
+	case MICROFACET_REFLECTION_T:
+		lobe->bxdf.reset(new MicrofacetReflectionT<TrowbridgeReitzDistribution, FresnelDielectric>(WHITE,
+			TrowbridgeReitzDistribution(alpha, alpha), FresnelDielectric(1.f, eta)));
+		break;
+	case MICROFACET_TRANSMISSION_T:
+		lobe->bxdf.reset(new MicrofacetTransmissionT<TrowbridgeReitzDistribution>(WHITE,
+			TrowbridgeReitzDistribution(alpha, alpha), 1.f, eta, TransportMode::Radiance));
+		break;
+	case FRESNEL_MICROFACET_T:
+		lobe->bxdf.reset(new FresnelMicrofacetT<TrowbridgeReitzDistribution>(WHITE, WHITE,
+			TrowbridgeReitzDistribution(alpha, alpha), 1.f, eta, TransportMode::Radiance));
+		break;
+	case FRESNEL_BLEND:
+		lobe->bxdf.reset(new FresnelBlend(GREY, SPECULAR, lobe->distribution.get()));
+		break;
+	case FOURIER_BSDF:
+		lobe->bxdf.reset(new FourierBSDF(table, TransportMode::Radiance));
+		break;
+	}
+}
+
+enum Method { SAMPLE_F, SAMPLE_F_BATCH, F, PDF, METHOD_COUNT };
+static const char *METHODS[METHOD_COUNT] = { "Sample_f", "Sample_f_batch", "f", "Pdf" };
+
+// Samples per Sample_f_batch call, about what a glossy lobe draws per shading point
+static const int BATCH = 16;
+
+// Calls method on every input, returns the seconds taken and sums the
+// results into checksum
+static double Run(const BxDF &bxdf, Method method, const Vector3f &wo, const std::vector<Point2f> &u,
+	const std::vector<Vector3f> &wi, double *checksum)
+{
+	double sum = 0.0;
+	const size_t n = u.size();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	switch (method) {
+	case SAMPLE_F:
+		for (size_t i = 0; i < n; i++) {
+			Vector3f sampled;
+			Float pdf = 0.f;
+			BxDFType type;
+			miColor f = bxdf.Sample_f(wo, &sampled, u[i], &pdf, &type);
+			sum += f.r + f.g + f.b + pdf;
+		}
+		break;
+	case SAMPLE_F_BATCH:
+		for (size_t i = 0; i < n; i += BATCH) {
+			int count = (int)std::min(n - i, (size_t)BATCH);
+			Vector3f sampled[BATCH];
+			miColor f[BATCH];
+			Float pdf[BATCH];
+			bxdf.Sample_f_batch(wo, count, &u[i], sampled, f, pdf);
+			for (int j = 0; j < count; j++)
+				sum += f[j].r + f[j].g + f[j].b + pdf[j];
+		}
+		break;
+	case F:
+		for (size_t i = 0; i < n; i++) {
+			miColor f = bxdf.f(wo, wi[i]);
+			sum += f.r + f.g + f.b;
+		}
+		break;
+	case PDF:
+		for (size_t i = 0; i < n; i++)
+			sum += bxdf.Pdf(wo, wi[i]);
+		break;
+	default:
+		break;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	*checksum = sum;
+	return seconds;
+}
+
+int main(int argc, char **argv)
+{
+	int calls = 100000;
+	const char *filter = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--calls") == 0 && i + 1 < argc)
+			calls = std::max(atoi(argv[++i]), 1);
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			filter = argv[++i];
+		else {
+			fprintf(stderr, "usage: %s [--calls n] [--filter text]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	// The same samples and directions for every lobe, directions over the
+	// whole sphere so the transmission lobes see both sides
+	RNG rng;
+	std::vector<Point2f> u(calls);
+	std::vector<Vector3f> wi(calls);
+	for (int i = 0; i < calls; i++) {
+		u[i] = Point2f(rng.UniformFloat(), rng.UniformFloat());
+		wi[i] = UniformSampleSphere(Point2f(rng.UniformFloat(), rng.UniformFloat()));
+	}
+
+	SyntheticFourierTable table;
+	bool first = true;
+
+	printf("{\"calls\": %d, \"results\": [", calls);
+	for (int kind = 0; kind < LOBE_COUNT; kind++) {
+		if (filter != NULL && strstr(LOBES[kind].name, filter) == NULL)
+			continue;
+
+		int nRoughness = LOBES[kind].sweep & SWEEP_ROUGHNESS ? 3 : 1;
+		int nEta = LOBES[kind].sweep & SWEEP_ETA ? 3 : 1;
+		for (int r = 0; r < nRoughness; r++) {
+			for (int e = 0; e < nEta; e++) {
+				Float roughness = LOBES[kind].sweep & SWEEP_ROUGHNESS ? ROUGHNESS[r] : ROUGHNESS[1];
+				Float eta = LOBES[kind].sweep & SWEEP_ETA ? ETA[e] : ETA[1];
+				Lobe lobe;
+				MakeLobe(kind, roughness, eta, table, &lobe);
+
+				for (Float degrees : THETA_DEGREES) {
+					Float theta = Radians(degrees);
+					Vector3f wo(std::sin(theta), 0.f, std::cos(theta));
+
+					for (int m = 0; m < METHOD_COUNT; m++) {
+						double checksum;
+						double seconds = Run(*lobe.bxdf, (Method)m, wo, u, wi, &checksum);
+
+						printf("%s\n  {\"bxdf\": \"%s\", \"method\": \"%s\", \"roughness\": %g, \"eta\": %g, \"theta_deg\": %g, "
+							"\"ns_per_call\": %.2f, \"checksum\": %.6g}",
+							first ? "" : ",", LOBES[kind].name, METHODS[m], roughness, eta, degrees,
+							1e9 * seconds / calls, checksum);
+						first = false;
+					}
+				}
+			}
+		}
+	}
+	printf("\n]}\n");
+	return 0;
+}
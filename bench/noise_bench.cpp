@@ -0,0 +1,108 @@
+// Times miaux_summed_noise, which calls mi_unoise_3d per octave, against the
+// built-in gradient noise of auxil/miaux_noise.h one point and a batch of
+// points at a time, over a sweep of octave counts, and prints the results as
+// JSON. Points come from the fixed-seed RNG of core/rng.h. Against the
+// stand-in runtime mi_unoise_3d is mr_mock's scalar Perlin noise.
+//
+//     noise_bench [--points n] [--passes n]
+
+#include "slh_aux.h"
+#include "rng.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+enum Method { SUMMED_NOISE, GRADIENT, GRADIENT_BATCH, METHOD_COUNT };
+static const char *METHODS[METHOD_COUNT] = { "mi_unoise_3d", "gradient", "gradient_batch" };
+
+static const int OCTAVES[] = { 1, 4, 7 };
+static const double SUMMING_WEIGHT = 2.0, OCTAVE_SCALING = 2.0;
+
+// Points per miaux_gradient_summed_noise_batch call, about one march
+static const int BATCH = 64;
+
+// Evaluates every point, returns the seconds taken and the mean value
+static double Run(Method method, int octaves, std::vector<miVector> &points, std::vector<miScalar> &values,
+	double *mean)
+{
+	const int n = (int)points.size();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	switch (method) {
+	case SUMMED_NOISE:
+		for (int i = 0; i < n; i++)
+			values[i] = (miScalar)miaux_summed_noise(&points[i], SUMMING_WEIGHT, OCTAVE_SCALING, octaves);
+		break;
+	case GRADIENT:
+		for (int i = 0; i < n; i++)
+			values[i] = (miScalar)miaux_gradient_summed_noise(&points[i], SUMMING_WEIGHT, OCTAVE_SCALING, octaves);
+		break;
+	case GRADIENT_BATCH:
+		for (int i = 0; i < n; i += BATCH)
+			miaux_gradient_summed_noise_batch(&values[i], &points[i], std::min(n - i, BATCH),
+				SUMMING_WEIGHT, OCTAVE_SCALING, octaves);
+		break;
+	default:
+		break;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	double sum = 0.0;
+	for (int i = 0; i < n; i++)
+		sum += values[i];
+	*mean = sum / n;
+	return seconds;
+}
+
+int main(int argc, char **argv)
+{
+	int count = 65536, passes = 3;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--points") == 0 && i + 1 < argc)
+			count = std::max(atoi(argv[++i]), 1);
+		else if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc)
+			passes = std::max(atoi(argv[++i]), 1);
+		else {
+			fprintf(stderr, "usage: %s [--points n] [--passes n]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	pbrt::RNG rng;
+	std::vector<miVector> points(count);
+	std::vector<miScalar> values(count);
+	for (int i = 0; i < count; i++) {
+		points[i].x = 16.f * rng.UniformFloat();
+		points[i].y = 16.f * rng.UniformFloat();
+		points[i].z = 16.f * rng.UniformFloat();
+	}
+
+#if defined(SLH_NO_SIMD)
+	const bool simd = false;
+#else
+	const bool simd = true;
+#endif
+	bool first = true;
+
+	printf("{\"points\": %d, \"simd\": %s, \"results\": [", count, simd ? "true" : "false");
+	for (int octaves : OCTAVES) {
+		for (int m = 0; m < METHOD_COUNT; m++) {
+			// Fastest pass, the others are mostly scheduling noise
+			double seconds = 0.0, mean = 0.0;
+			for (int pass = 0; pass < passes; pass++) {
+				double t = Run((Method)m, octaves, points, values, &mean);
+				seconds = pass == 0 ? t : std::min(seconds, t);
+			}
+
+			printf("%s\n  {\"method\": \"%s\", \"octaves\": %d, \"ns_per_point\": %.2f, \"mean\": %.6f}",
+				first ? "" : ",", METHODS[m], octaves, 1e9 * seconds / count, mean);
+			first = false;
+		}
+	}
+	printf("\n]}\n");
+	return 0;
+}
@@ -0,0 +1,620 @@
+// Renders the analytic scene of the stand-in runtime (mr_mock/mr_mock.h) with
+// every shader entry point and prints per-case timings (of the fastest pass),
+// ray and sample counts as JSON. Cases with a reference are also rendered at 16 times the samples,
+// and report the RMS error and the mean offset of a single pass against it.
+//
+//     slh_bench [--passes n] [--size width height] [--filter text] [--no-reference]
+//
+// slh_bench_scalar is the same driver on shaders built with SLH_NO_SIMD.
+
+#include "mr_mock.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Parameter blocks, laid out as declared in include/slh_shaders.mi and
+// include/slh_mixers.mi
+struct slh_glass_params {
+	miScalar	eta;
+	miColor		reflect_k;
+	miScalar	reflection_roughness;
+	int			reflection_samples;
+	miColor		refract_k;
+	miScalar	transmission_roughness;
+	int			transmission_samples;
+	miVector	bump;
+	miScalar	adaptive_threshold;
+	int			min_samples;
+	miBoolean	stochastic;
+};
+
+struct slh_metal_params {
+	miColor		eta;
+	miColor		k;
+	miScalar	roughness;
+	int			samples;
+	miVector	bump;
+	miScalar	adaptive_threshold;
+	int			min_samples;
+};
+
+struct slh_plastic_params {
+	miScalar	eta;
+	miColor		reflect_k;
+	miScalar	roughness;
+	miColor		diffuse_k;
+	miScalar	sigma;
+	int			samples;
+	miVector	bump;
+	miScalar	adaptive_threshold;
+	int			min_samples;
+	miBoolean	mis;
+	int			i_light;
+	int			n_light;
+	miTag		lights[1];
+};
+
+struct slh_metal_schlick_params {
+	miColor		color;
+};
+
+struct slh_dispersion_params {
+	miScalar	ior;
+	miColor		refraction_color;
+	miScalar	scatter;
+	int			samples;
+	miBoolean	spectral;
+	int			ior_model;
+	int			preset;
+	miScalar	cauchy_a, cauchy_b, cauchy_c;
+	miScalar	sellmeier_b1, sellmeier_b2, sellmeier_b3;
+	miScalar	sellmeier_c1, sellmeier_c2, sellmeier_c3;
+};
+
+struct shader_list {
+	miScalar	weight;
+	miTag		shader;
+};
+
+struct slh_layer_params {
+	int			i_list;
+	int			n_list;
+	shader_list	s_list[1];
+	miVector	bump;
+	miBoolean	stochastic;
+};
+
+template <typename T> struct slh_mix_params {
+	T			A;
+	T			B;
+	miScalar	F;
+};
+
+struct slh_mix_mia {
+	miScalar	diffuse_weight;
+	miColor		diffuse;
+	miScalar	diffuse_roughness;
+	miScalar	reflectivity;
+	miColor		refl_color;
+	miScalar	refl_gloss;
+	int			refl_gloss_samples;
+	miBoolean	refl_interpolate, refl_hl_only, refl_is_metal;
+	miScalar	transparency;
+	miColor		refr_color;
+	miScalar	refr_gloss;
+	miScalar	refr_ior;
+	int			refr_gloss_samples;
+	miBoolean	refr_interpolate, refr_translucency;
+	miColor		refr_trans_color;
+	miScalar	refr_trans_weight;
+	miScalar	anisotropy;
+	miScalar	anisotropy_rotation;
+	int			anisotropy_channel;
+	miBoolean	brdf_fresnel;
+	miScalar	brdf_0_degree_refl, brdf_90_degree_refl, brdf_curve;
+	miBoolean	brdf_conserve_energy;
+	miBoolean	refl_falloff_on;
+	miScalar	refl_falloff_dist;
+	miBoolean	refl_falloff_color_on;
+	miColor		refl_falloff_color;
+	int			refl_depth;
+	miScalar	refl_cutoff;
+	miBoolean	refr_falloff_on;
+	miScalar	refr_falloff_dist;
+	miBoolean	refr_falloff_color_on;
+	miColor		refr_falloff_color;
+	int			refr_depth;
+	miScalar	refr_cutoff;
+	miBoolean	ao_on;
+	int			ao_samples;
+	miScalar	ao_distance;
+	miColor		ao_dark, ao_ambient;
+	int			ao_do_details;
+	miBoolean	thin_walled, no_visible_area_hl, skip_inside_refl, do_refractive_caustics, backface_cull, propagate_alpha;
+	miScalar	hl_vs_refl_balance;
+	miScalar	cutout_opacity;
+	miColor		additional_color;
+};
+
+struct slh_mix_mia_in {
+	miScalar	mask;
+	slh_mix_mia	A;
+	slh_mix_mia	B;
+};
+
+struct slh_lightPlate_params {
+	miColor		color;
+	miScalar	intensity;
+	miScalar	fg_multiplier;
+	miScalar	transparency;
+};
+
+struct slh_heightRamp_params {
+	miScalar	black_height;
+	miScalar	white_height;
+};
+
+// Parameters followed by the storage of their array. mental ray stores arrays
+// after the parameter block, with the index counted from the array member.
+template <typename P, typename E, int N> struct with_array {
+	P	params;
+	E	items[N];
+
+	int offset(const E *array) const {
+		return (int)(((const char*)items - (const char*)array) / sizeof(E));
+	}
+};
+
+// The entry points, with the signatures mr_mock calls them through
+#define SHADER(name) \
+	miBoolean name(void *result, miState *state, void *params); \
+	int name##_version(void);
+#define SHADER_INIT(name) SHADER(name) \
+	miBoolean name##_init(miState *state, void *params, miBoolean *instance_init_required); \
+	miBoolean name##_exit(miState *state, void *params);
+
+extern "C" {
+SHADER_INIT(slh_glass)
+SHADER_INIT(slh_metal)
+SHADER_INIT(slh_plastic)
+SHADER(slh_metal_schlick)
+SHADER_INIT(slh_dispersion)
+SHADER(slh_layer)
+SHADER(slh_mix_colors)
+SHADER(slh_mix_scalars)
+SHADER(slh_mix_booleans)
+SHADER(slh_mix_int)
+SHADER_INIT(slh_mix_mia)
+SHADER(slh_lightPlate)
+SHADER(slh_heightRamp)
+SHADER(slh_alphaShade)
+}
+
+#define ADD_SHADER(name, params) mr_mock_add_shader(name, NULL, NULL, params)
+#define ADD_SHADER_INIT(name, params) mr_mock_add_shader(name, name##_init, name##_exit, params)
+
+static const miColor WHITE = { 1.f, 1.f, 1.f, 1.f };
+static const miVector NO_BUMP = { 0.f, 0.f, 0.f };
+
+static miColor rgb(miScalar r, miScalar g, miScalar b)
+{
+	miColor c = { r, g, b, 1.f };
+	return c;
+}
+
+static miVector xyz(miScalar x, miScalar y, miScalar z)
+{
+	miVector v = { x, y, z };
+	return v;
+}
+
+// Scene --------------------------------------------------------------------
+
+static miTag scene_lights[2];
+
+// A unit sphere carrying the shader under test, in front of a smaller diffuse
+// sphere on a ground plane, lit by a point light and a visible rectangle light
+static miTag build_scene(void)
+{
+	mr_mock_reset();
+	mr_mock_set_environment(rgb(0.3f, 0.4f, 0.6f));
+	mr_mock_set_camera(xyz(0.f, 1.2f, -4.f), xyz(0.f, 0.f, 0.f), 0.6f);
+
+	miTag sphere = mr_mock_add_sphere(xyz(0.f, 0.f, 0.f), 1.f, rgb(0.5f, 0.5f, 0.5f));
+	mr_mock_add_sphere(xyz(1.4f, -0.5f, 1.5f), 0.5f, rgb(0.7f, 0.2f, 0.1f));
+	mr_mock_add_ground(-1.f, rgb(0.4f, 0.4f, 0.4f));
+
+	scene_lights[0] = mr_mock_add_point_light(xyz(-4.f, 5.f, -3.f), rgb(30.f, 30.f, 30.f));
+	scene_lights[1] = mr_mock_add_rectangle_light(xyz(1.5f, 3.f, -1.f), xyz(1.5f, 0.f, 0.f), xyz(0.f, 0.f, 1.5f), rgb(6.f, 6.f, 6.f), 4);
+	return sphere;
+}
+
+// Cases --------------------------------------------------------------------
+
+// Every setup adds the shader to call, with its sample counts times quality.
+// The parameter blocks are static, mr_mock keeps pointers to them.
+typedef miTag (*setup_fn)(int quality);
+
+static miTag glass(miScalar roughness, int quality, miScalar threshold, miBoolean stochastic)
+{
+	static slh_glass_params p;
+	p.eta = 1.5f;
+	p.reflect_k = WHITE;
+	p.reflection_roughness = roughness;
+	p.reflection_samples = 8 * quality;
+	p.refract_k = WHITE;
+	p.transmission_roughness = roughness;
+	p.transmission_samples = 8 * quality;
+	p.bump = NO_BUMP;
+	p.adaptive_threshold = threshold;
+	p.min_samples = 4;
+	p.stochastic = stochastic;
+	return ADD_SHADER_INIT(slh_glass, &p);
+}
+
+static miTag glass_specular(int q)			{ return glass(0.f, q, 0.f, miFALSE); }
+static miTag glass_glossy(int q)			{ return glass(0.15f, q, 0.f, miFALSE); }
+static miTag glass_glossy_adaptive(int q)	{ return glass(0.15f, q, 0.05f, miFALSE); }
+static miTag glass_glossy_stochastic(int q)	{ return glass(0.15f, q, 0.f, miTRUE); }
+
+static miTag metal(miScalar roughness, int quality, miScalar threshold)
+{
+	static slh_metal_params p;
+	p.eta = rgb(0.2f, 0.92f, 1.1f);
+	p.k = rgb(3.9f, 2.45f, 2.14f);
+	p.roughness = roughness;
+	p.samples = 8 * quality;
+	p.bump = NO_BUMP;
+	p.adaptive_threshold = threshold;
+	p.min_samples = 4;
+	return ADD_SHADER_INIT(slh_metal, &p);
+}
+
+static miTag metal_specular(int q)			{ return metal(0.f, q, 0.f); }
+static miTag metal_glossy(int q)			{ return metal(0.2f, q, 0.f); }
+static miTag metal_glossy_adaptive(int q)	{ return metal(0.2f, q, 0.05f); }
+
+// With area_only the shader gets the rectangle light alone. Traced glossy rays can't find the point
+// light, so only then does the traced-only render see the same highlights as the MIS one
+static slh_plastic_params *plastic_params(int quality, miBoolean mis, miScalar threshold, bool area_only = false)
+{
+	static with_array<slh_plastic_params, miTag, 2> p;
+	p.params.eta = 1.5f;
+	p.params.reflect_k = WHITE;
+	p.params.roughness = 0.2f;
+	p.params.diffuse_k = rgb(0.5f, 0.1f, 0.1f);
+	p.params.sigma = 0.3f;
+	p.params.samples = 8 * quality;
+	p.params.bump = NO_BUMP;
+	p.params.adaptive_threshold = threshold;
+	p.params.min_samples = 4;
+	p.params.mis = mis;
+	p.params.i_light = p.offset(p.params.lights);
+	p.params.n_light = area_only ? 1 : 2;
+	p.items[0] = scene_lights[area_only ? 1 : 0];
+	p.items[1] = scene_lights[1];
+	return &p.params;
+}
+
+static miTag plastic(int q)					{ return ADD_SHADER_INIT(slh_plastic, plastic_params(q, miFALSE, 0.f)); }
+static miTag plastic_mis(int q)				{ return ADD_SHADER_INIT(slh_plastic, plastic_params(q, miTRUE, 0.f)); }
+static miTag plastic_mis_adaptive(int q)	{ return ADD_SHADER_INIT(slh_plastic, plastic_params(q, miTRUE, 0.05f)); }
+static miTag plastic_area(int q)			{ return ADD_SHADER_INIT(slh_plastic, plastic_params(q, miFALSE, 0.f, true)); }
+static miTag plastic_mis_area(int q)		{ return ADD_SHADER_INIT(slh_plastic, plastic_params(q, miTRUE, 0.f, true)); }
+
+static miTag metal_schlick(int q)
+{
+	static slh_metal_schlick_params p = { { 1.f, 0.78f, 0.34f, 1.f } };
+	return ADD_SHADER(slh_metal_schlick, &p);
+}
+
+static miTag dispersion(int quality, miBoolean spectral, int model)
+{
+	static slh_dispersion_params p;
+	memset(&p, 0, sizeof(p));
+	p.ior = 1.5f;
+	p.refraction_color = WHITE;
+	p.scatter = 0.03f;
+	p.samples = 6 * quality;
+	p.spectral = spectral;
+	p.ior_model = model;
+	p.preset = 1;
+	return ADD_SHADER_INIT(slh_dispersion, &p);
+}
+
+static miTag dispersion_rgb(int q)				{ return dispersion(q, miFALSE, 0); }
+static miTag dispersion_spectral(int q)			{ return dispersion(q, miTRUE, 0); }
+static miTag dispersion_spectral_sellmeier(int q)	{ return dispersion(q, miTRUE, 2); }
+
+static miTag layer(int quality, miBoolean stochastic)
+{
+	static with_array<slh_layer_params, shader_list, 2> p;
+	p.params.i_list = p.offset(p.params.s_list);
+	p.params.n_list = 2;
+	p.params.bump = NO_BUMP;
+	p.params.stochastic = stochastic;
+	p.items[0].weight = 0.5f;
+	p.items[0].shader = plastic(quality);
+	p.items[1].weight = 1.f;
+	p.items[1].shader = metal_glossy(quality);
+	return ADD_SHADER(slh_layer, &p.params);
+}
+
+static miTag layer_all(int q)			{ return layer(q, miFALSE); }
+static miTag layer_stochastic(int q)	{ return layer(q, miTRUE); }
+
+static miTag mix_colors(int q)
+{
+	static slh_mix_params<miColor> p = { { 1.f, 0.f, 0.f, 1.f }, { 0.f, 0.f, 1.f, 1.f }, 0.25f };
+	return ADD_SHADER(slh_mix_colors, &p);
+}
+
+static miTag mix_scalars(int q)
+{
+	static slh_mix_params<miScalar> p = { 0.2f, 0.8f, 0.5f };
+	return ADD_SHADER(slh_mix_scalars, &p);
+}
+
+static miTag mix_booleans(int q)
+{
+	static slh_mix_params<miBoolean> p = { miTRUE, miFALSE, 0.3f };
+	return ADD_SHADER(slh_mix_booleans, &p);
+}
+
+static miTag mix_int(int q)
+{
+	static slh_mix_params<int> p = { 2, 10, 0.5f };
+	return ADD_SHADER(slh_mix_int, &p);
+}
+
+static miTag mix_mia(miBoolean connected)
+{
+	static slh_mix_mia_in p;
+	memset(&p, 0, sizeof(p));
+	p.mask = 0.5f;
+	p.A.diffuse_weight = p.B.diffuse_weight = 1.f;
+	p.A.diffuse = rgb(0.8f, 0.2f, 0.2f);
+	p.B.diffuse = rgb(0.2f, 0.2f, 0.8f);
+	p.A.reflectivity = 0.6f;
+	p.B.reflectivity = 0.3f;
+	p.A.refl_color = p.B.refl_color = WHITE;
+	p.A.refl_gloss = 0.8f;
+	p.B.refl_gloss = 0.4f;
+	p.A.refl_gloss_samples = p.B.refl_gloss_samples = 8;
+	p.A.refr_ior = p.B.refr_ior = 1.4f;
+	p.A.brdf_fresnel = miTRUE;
+	p.A.brdf_90_degree_refl = p.B.brdf_90_degree_refl = 1.f;
+	p.A.brdf_curve = p.B.brdf_curve = 5.f;
+	p.A.refl_depth = p.B.refl_depth = -1;
+	p.A.refr_depth = p.B.refr_depth = -1;
+
+	// Connections have to be made before the instance init sees them
+	if (connected) {
+		mr_mock_connect(&p.mask, mix_scalars(1));
+		mr_mock_connect(&p.B.diffuse, mix_colors(1));
+	}
+	return ADD_SHADER_INIT(slh_mix_mia, &p);
+}
+
+static miTag mix_mia_constant(int q)	{ return mix_mia(miFALSE); }
+static miTag mix_mia_connected(int q)	{ return mix_mia(miTRUE); }
+
+static miTag light_plate(int q)
+{
+	static slh_lightPlate_params p = { { 1.f, 0.9f, 0.8f, 1.f }, 2.f, 1.f, 0.f };
+	return ADD_SHADER(slh_lightPlate, &p);
+}
+
+static miTag height_ramp(int q)
+{
+	static slh_heightRamp_params p = { -1.f, 1.f };
+	return ADD_SHADER(slh_heightRamp, &p);
+}
+
+static miTag alpha_shade(int q)
+{
+	return ADD_SHADER(slh_alphaShade, NULL);
+}
+
+struct bench_case {
+	const char	*name;
+	setup_fn	setup;
+	size_t		result_size;	// called on the eye ray hit instead of as material when set
+	const char	*reference;		// case rendered at 16 times the samples, NULL for none
+};
+
+static const bench_case CASES[] = {
+	{ "glass_specular",					glass_specular,					0, NULL },
+	{ "glass_glossy",					glass_glossy,					0, "glass_glossy" },
+	{ "glass_glossy_adaptive",			glass_glossy_adaptive,			0, "glass_glossy" },
+	{ "glass_glossy_stochastic",		glass_glossy_stochastic,		0, "glass_glossy" },
+	{ "metal_specular",					metal_specular,					0, NULL },
+	{ "metal_glossy",					metal_glossy,					0, "metal_glossy" },
+	{ "metal_glossy_adaptive",			metal_glossy_adaptive,			0, "metal_glossy" },
+	{ "plastic",						plastic,						0, "plastic" },
+	{ "plastic_mis",					plastic_mis,					0, "plastic_mis" },
+	{ "plastic_mis_adaptive",			plastic_mis_adaptive,			0, "plastic_mis" },
+	{ "plastic_area",					plastic_area,					0, "plastic_area" },
+	{ "plastic_mis_area",				plastic_mis_area,				0, "plastic_area" },
+	{ "metal_schlick",					metal_schlick,					0, NULL },
+	{ "dispersion_rgb",					dispersion_rgb,					0, "dispersion_rgb" },
+	{ "dispersion_spectral",			dispersion_spectral,			0, "dispersion_spectral" },
+	{ "dispersion_spectral_sellmeier",	dispersion_spectral_sellmeier,	0, "dispersion_spectral_sellmeier" },
+	{ "layer",							layer_all,						0, "layer" },
+	{ "layer_stochastic",				layer_stochastic,				0, "layer" },
+	{ "mix_colors",						mix_colors,						0, NULL },
+	{ "mix_scalars",					mix_scalars,					sizeof(miScalar), NULL },
+	{ "mix_booleans",					mix_booleans,					sizeof(miBoolean), NULL },
+	{ "mix_int",						mix_int,						sizeof(int), NULL },
+	{ "mix_mia_constant",				mix_mia_constant,				sizeof(struct slh_mix_mia), NULL },
+	{ "mix_mia_connected",				mix_mia_connected,				sizeof(struct slh_mix_mia), NULL },
+	{ "light_plate",					light_plate,					0, NULL },
+	{ "height_ramp",					height_ramp,					0, NULL },
+	{ "alpha_shade",					alpha_shade,					0, NULL },
+};
+
+static const int NUM_CASES = sizeof(CASES) / sizeof(CASES[0]);
+
+// Rendering ----------------------------------------------------------------
+
+struct bench_options {
+	int			passes;
+	int			width, height;
+	const char	*filter;
+	bool		reference;
+};
+
+struct render_result {
+	double				seconds;	// fastest pass
+	mr_mock_stats		stats;
+	std::vector<miColor>	image;	// passes * width * height
+};
+
+static void render(const bench_case &c, int quality, const bench_options &opt, render_result *out)
+{
+	miTag sphere = build_scene();
+	miTag shader = c.setup(quality);
+	if (c.result_size == 0)
+		mr_mock_set_material(sphere, shader);
+
+	std::vector<double> result((c.result_size + sizeof(double) - 1) / sizeof(double) + 1);
+	miState state;
+	const int pixels = opt.width * opt.height;
+
+	out->image.assign((size_t)opt.passes * pixels, rgb(0.f, 0.f, 0.f));
+	mr_mock_reset_stats();
+
+	out->seconds = 0.0;
+	for (int pass = 0; pass < opt.passes; pass++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < pixels; i++) {
+			double x = (i % opt.width + 0.5) / opt.width, y = (i / opt.width + 0.5) / opt.height;
+			unsigned seed = (unsigned)(pass * pixels + i);
+			miColor *pixel = &out->image[(size_t)pass * pixels + i];
+
+			if (c.result_size == 0)
+				mr_mock_trace_eye(pixel, x, y, seed);
+			else if (mr_mock_eye_state(&state, x, y, seed)) {
+				mi_call_shader((miColor*)result.data(), miSHADER_TEXTURE, &state, shader);
+				if (c.result_size >= sizeof(miColor))
+					*pixel = *(miColor*)result.data();
+			}
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (pass == 0 || seconds < out->seconds)
+			out->seconds = seconds;
+	}
+	mr_mock_get_stats(&out->stats);
+}
+
+static const bench_case *find_case(const char *name)
+{
+	for (int i = 0; i < NUM_CASES; i++) {
+		if (strcmp(CASES[i].name, name) == 0)
+			return &CASES[i];
+	}
+	return NULL;
+}
+
+static void print_case(const bench_case &c, const bench_options &opt, bool first)
+{
+	render_result r;
+	render(c, 1, opt, &r);
+
+	double calls = (double)r.stats.eye_rays;
+	double mean[3] = { 0.0, 0.0, 0.0 };
+	for (size_t i = 0; i < r.image.size(); i++) {
+		mean[0] += r.image[i].r;
+		mean[1] += r.image[i].g;
+		mean[2] += r.image[i].b;
+	}
+	for (int k = 0; k < 3; k++)
+		mean[k] /= r.image.size();
+
+	printf("%s\n    {\"name\": \"%s\", \"calls\": %.0f, \"ns_per_call\": %.1f,\n", first ? "" : ",", c.name, calls, 1e9 * r.seconds * opt.passes / calls);
+	printf("     \"per_call\": {\"reflection_rays\": %.3f, \"refraction_rays\": %.3f, \"environment_rays\": %.3f, \"shadow_rays\": %.3f, "
+		"\"light_samples\": %.3f, \"shader_calls\": %.3f, \"sample_loops\": %.3f},\n",
+		r.stats.reflection_rays / calls, r.stats.refraction_rays / calls, r.stats.environment_rays / calls, r.stats.shadow_rays / calls,
+		r.stats.light_samples / calls, r.stats.shader_calls / calls, r.stats.sample_loops / calls);
+	printf("     \"unfinished_sample_loops\": %llu", r.stats.unfinished_sample_loops);
+	if (c.result_size == 0 || c.result_size >= sizeof(miColor))
+		printf(", \"mean\": [%.5f, %.5f, %.5f]", mean[0], mean[1], mean[2]);
+
+	const bench_case *ref = c.reference && opt.reference ? find_case(c.reference) : NULL;
+	if (ref != NULL) {
+		bench_options ref_opt = opt;
+		ref_opt.passes = 1;
+		render_result reference;
+		render(*ref, 16, ref_opt, &reference);
+
+		// Error of every pass against the one reference image, and the mean offset from it
+		const size_t pixels = reference.image.size();
+		double err = 0.0, bias[3] = { 0.0, 0.0, 0.0 };
+		for (size_t i = 0; i < r.image.size(); i++) {
+			const miColor &a = r.image[i], &b = reference.image[i % pixels];
+			err += (a.r - b.r) * (a.r - b.r) + (a.g - b.g) * (a.g - b.g) + (a.b - b.b) * (a.b - b.b);
+			bias[0] += a.r - b.r;
+			bias[1] += a.g - b.g;
+			bias[2] += a.b - b.b;
+		}
+		printf(", \"rmse\": %.6f, \"bias\": [%.5f, %.5f, %.5f]", sqrt(err / (3.0 * r.image.size())),
+			bias[0] / r.image.size(), bias[1] / r.image.size(), bias[2] / r.image.size());
+	}
+	printf("}");
+}
+
+int main(int argc, char **argv)
+{
+	bench_options opt = { 2, 32, 24, NULL, true };
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc)
+			opt.passes = std::max(atoi(argv[++i]), 1);
+		else if (strcmp(argv[i], "--size") == 0 && i + 2 < argc) {
+			opt.width = std::max(atoi(argv[++i]), 1);
+			opt.height = std::max(atoi(argv[++i]), 1);
+		}
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			opt.filter = argv[++i];
+		else if (strcmp(argv[i], "--no-reference") == 0)
+			opt.reference = false;
+		else {
+			fprintf(stderr, "usage: %s [--passes n] [--size width height] [--filter text] [--no-reference]\n", argv[0]);
+			return 1;
+		}
+	}
+
+#ifdef SLH_NO_SIMD
+	const char *simd = "false";
+#else
+	const char *simd = "true";
+#endif
+	printf("{\"runtime\": \"mr_mock\", \"simd\": %s, \"passes\": %d, \"size\": [%d, %d],\n", simd, opt.passes, opt.width, opt.height);
+	printf(" \"versions\": {\"slh_glass\": %d, \"slh_metal\": %d, \"slh_plastic\": %d, \"slh_metal_schlick\": %d, \"slh_dispersion\": %d, "
+		"\"slh_layer\": %d, \"slh_mix_colors\": %d, \"slh_mix_scalars\": %d, \"slh_mix_booleans\": %d, \"slh_mix_int\": %d, "
+		"\"slh_mix_mia\": %d, \"slh_lightPlate\": %d, \"slh_heightRamp\": %d, \"slh_alphaShade\": %d},\n",
+		slh_glass_version(), slh_metal_version(), slh_plastic_version(), slh_metal_schlick_version(), slh_dispersion_version(),
+		slh_layer_version(), slh_mix_colors_version(), slh_mix_scalars_version(), slh_mix_booleans_version(), slh_mix_int_version(),
+		slh_mix_mia_version(), slh_lightPlate_version(), slh_heightRamp_version(), slh_alphaShade_version());
+	printf(" \"cases\": [");
+
+	bool first = true;
+	for (int i = 0; i < NUM_CASES; i++) {
+		if (opt.filter != NULL && strstr(CASES[i].name, opt.filter) == NULL)
+			continue;
+		print_case(CASES[i], opt, first);
+		first = false;
+		fflush(stdout);
+	}
+	printf("\n ]}\n");
+
+	mr_mock_reset();
+	return 0;
+}
@@ -0,0 +1,128 @@
+// Times the SampledSpectrum operations of pbrt/core/spectrum.h over a set of
+// reflectance spectra built from fixed-seed RGB colours and prints the
+// results as JSON. spectrum_bench runs the SpectrumLanes paths,
+// spectrum_bench_scalar the same code built with SLH_NO_SIMD.
+//
+//     spectrum_bench [--spectra n] [--rounds n] [--filter text]
+
+#include "spectrum.h"
+#include "rng.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace pbrt;
+
+enum Op { ARITHMETIC, DIVIDE, SQRT_CLAMP, IS_BLACK_MAX, Y, TO_RGB, FROM_RGB, OP_COUNT };
+static const char *OPS[OP_COUNT] = { "arithmetic", "divide", "sqrt_clamp", "is_black_max", "y", "to_rgb", "from_rgb" };
+
+struct Inputs {
+	std::vector<SampledSpectrum> a, b;
+	std::vector<Float> rgb;
+};
+
+// Runs op over every spectrum rounds times, returns the seconds taken and
+// sums the results into checksum
+static double Run(Op op, const Inputs &in, int rounds, double *checksum)
+{
+	const int n = (int)in.a.size();
+	double sum = 0.0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++) {
+		switch (op) {
+		case ARITHMETIC:
+			for (int i = 0; i < n; i++)
+				sum += (in.a[i] * in.b[i] + in.a[i] * 0.5f - in.b[i])[i % nSpectralSamples];
+			break;
+		case DIVIDE:
+			for (int i = 0; i < n; i++)
+				sum += (in.a[i] / in.b[i])[i % nSpectralSamples];
+			break;
+		case SQRT_CLAMP:
+			for (int i = 0; i < n; i++)
+				sum += Sqrt(in.a[i] + in.b[i]).Clamp(0.f, 0.75f)[i % nSpectralSamples];
+			break;
+		case IS_BLACK_MAX:
+			for (int i = 0; i < n; i++)
+				sum += in.a[i].IsBlack() ? 0.f : in.a[i].MaxComponentValue();
+			break;
+		case Y:
+			for (int i = 0; i < n; i++)
+				sum += in.a[i].y();
+			break;
+		case TO_RGB:
+			for (int i = 0; i < n; i++) {
+				Float rgb[3];
+				in.a[i].ToRGB(rgb);
+				sum += rgb[0] + rgb[1] + rgb[2];
+			}
+			break;
+		case FROM_RGB:
+			for (int i = 0; i < n; i++)
+				sum += SampledSpectrum::FromRGB(&in.rgb[3 * i], SpectrumType::Reflectance)[i % nSpectralSamples];
+			break;
+		default:
+			break;
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	*checksum = sum;
+	return seconds;
+}
+
+int main(int argc, char **argv)
+{
+	int count = 4096, rounds = 20;
+	const char *filter = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--spectra") == 0 && i + 1 < argc)
+			count = std::max(atoi(argv[++i]), 1);
+		else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+			rounds = std::max(atoi(argv[++i]), 1);
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			filter = argv[++i];
+		else {
+			fprintf(stderr, "usage: %s [--spectra n] [--rounds n] [--filter text]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	RNG rng;
+	Inputs in;
+	in.rgb.resize(3 * count);
+	for (int i = 0; i < 3 * count; i++)
+		in.rgb[i] = rng.UniformFloat();
+	for (int i = 0; i < count; i++) {
+		in.a.push_back(SampledSpectrum::FromRGB(&in.rgb[3 * i], SpectrumType::Reflectance));
+		in.b.push_back(SampledSpectrum::FromRGB(&in.rgb[3 * ((i + 1) % count)], SpectrumType::Reflectance) + 0.1f);
+	}
+
+#ifdef PBRT_SPECTRUM_LANES
+	const bool simd = true;
+#else
+	const bool simd = false;
+#endif
+	bool first = true;
+
+	printf("{\"spectra\": %d, \"rounds\": %d, \"simd\": %s, \"results\": [", count, rounds, simd ? "true" : "false");
+	for (int op = 0; op < OP_COUNT; op++) {
+		if (filter != NULL && strstr(OPS[op], filter) == NULL)
+			continue;
+
+		double checksum;
+		double seconds = Run((Op)op, in, rounds, &checksum);
+
+		printf("%s\n  {\"op\": \"%s\", \"ns_per_op\": %.2f, \"checksum\": %.6g}",
+			first ? "" : ",", OPS[op], 1e9 * seconds / ((double)count * rounds), checksum);
+		first = false;
+	}
+	printf("\n]}\n");
+	return 0;
+}
@@ -0,0 +1,38 @@
+/*
+   Stand-in for the mental ray geoshader.h, see mr_mock.h
+
+   The scene construction calls the hair and placeholder helpers in miaux
+   make. The mock keeps the last object's arrays so they can be inspected.
+*/
+
+#ifndef GEOSHADER_H
+#define GEOSHADER_H
+
+#include "shader.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+miObject *mi_api_object_begin(char *name);
+miTag mi_api_object_end(void);
+miBoolean mi_api_object_file(char *filename);
+miBoolean mi_api_object_callback(miApi_object_callback callback, void *data);
+
+miBoolean mi_api_vector_xyz_add(miVector *v);
+miBoolean mi_api_vertex_add(int index);
+miBoolean mi_api_poly_begin_tag(int type, miTag material);
+miBoolean mi_api_poly_index_add(int index);
+miBoolean mi_api_poly_end(void);
+
+miBoolean mi_api_hair_info(int index, char type, int count);
+miScalar *mi_api_hair_scalars_begin(int count);
+miBoolean mi_api_hair_scalars_end(int count);
+miGeoIndex *mi_api_hair_hairs_begin(int count);
+miBoolean mi_api_hair_hairs_end(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
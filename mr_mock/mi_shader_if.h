@@ -0,0 +1,42 @@
+/*
+   Stand-in for the mental ray mi_shader_if.h, see mr_mock.h
+
+   Only the string options part of the C++ shader interface, the values are
+   set with mr_mock_set_string_option.
+*/
+
+#ifndef MI_SHADER_IF_H
+#define MI_SHADER_IF_H
+
+#include "shader.h"
+
+namespace mi {
+namespace shader {
+
+class Options {
+public:
+	virtual bool get(const char *name, const char **value) const = 0;
+	virtual bool get(const char *name, float *value) const = 0;
+	virtual bool get(const char *name, bool *value) const = 0;
+	virtual bool get(const char *name, int *value) const = 0;
+	virtual void release() const = 0;
+
+protected:
+	virtual ~Options() {}
+};
+
+class Interface {
+public:
+	virtual Options *getOptions(miTag string_options) = 0;
+	virtual void release() = 0;
+
+protected:
+	virtual ~Interface() {}
+};
+
+}  // namespace shader
+}  // namespace mi
+
+mi::shader::Interface *mi_get_shader_interface(int version = 1);
+
+#endif
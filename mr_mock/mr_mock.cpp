@@ -0,0 +1,1235 @@
+/*
+   Stand-in mental ray runtime, see mr_mock.h
+*/
+
+#include "mr_mock.h"
+#include "geoshader.h"
+#include "mi_shader_if.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define MR_MOCK_MAX_DEPTH	64
+#define MR_MOCK_EPSILON		1e-4f
+
+
+/* Vector arithmetic ------------------------------------------------------- */
+
+static inline miVector vec(miScalar x, miScalar y, miScalar z) { miVector v = { x, y, z }; return v; }
+static inline miVector add(const miVector &a, const miVector &b) { return vec(a.x + b.x, a.y + b.y, a.z + b.z); }
+static inline miVector sub(const miVector &a, const miVector &b) { return vec(a.x - b.x, a.y - b.y, a.z - b.z); }
+static inline miVector scale(const miVector &a, miScalar s) { return vec(a.x * s, a.y * s, a.z * s); }
+static inline miScalar dot(const miVector &a, const miVector &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static inline miVector cross(const miVector &a, const miVector &b)
+{
+	return vec(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+static inline miVector normalize(const miVector &a)
+{
+	miScalar l = sqrtf(dot(a, a));
+	return l > 0.f ? scale(a, 1.f / l) : a;
+}
+
+static inline miColor color(miScalar r, miScalar g, miScalar b) { miColor c = { r, g, b, 1.f }; return c; }
+static const miColor black = { 0.f, 0.f, 0.f, 1.f };
+
+
+/* Scene ------------------------------------------------------------------- */
+
+enum { TAG_SPHERE, TAG_GROUND, TAG_LIGHT, TAG_SHADER };
+
+/* Light shapes as numbered by miQ_LIGHT_AREA */
+enum { LIGHT_POINT = 0, LIGHT_RECTANGLE = 1 };
+
+struct Sphere {
+	miVector	center;
+	miScalar	radius;
+	miColor		diffuse;
+	miTag		material;
+};
+
+struct Ground {
+	miScalar	height;
+	miColor		diffuse;
+	miTag		material;
+};
+
+struct Light {
+	int			type;
+	miVector	origin, u, v, normal;
+	miScalar	area;
+	miColor		color;
+	int			samples;
+};
+
+struct ShaderInstance {
+	mr_mock_shader_fn	shader;
+	mr_mock_exit_fn		exit;
+	void				*params;
+	void				*user;
+};
+
+struct TagEntry {
+	int		kind;
+	int		index;
+};
+
+static std::vector<TagEntry>		tags;
+static std::vector<Sphere>			spheres;
+static std::vector<Ground>			grounds;
+static std::vector<Light>			lights;
+static std::vector<ShaderInstance>	shaders;
+static std::unordered_map<void*, miTag>	connections;
+static std::map<std::string, std::string>	string_options;
+
+static miOptions	options;
+static miColor		environment = { 0.f, 0.f, 0.f, 1.f };
+static miVector		camera_origin = { 0.f, 0.f, -5.f };
+static miVector		camera_forward = { 0.f, 0.f, 1.f }, camera_right = { 1.f, 0.f, 0.f }, camera_up = { 0.f, 1.f, 0.f };
+static miScalar		camera_tan = 0.4f;
+static mr_mock_stats	stats;
+
+static miTag new_tag(int kind, int index)
+{
+	TagEntry entry = { kind, index };
+	tags.push_back(entry);
+	return (miTag)tags.size();
+}
+
+static const TagEntry *find_tag(miTag tag, int kind)
+{
+	if (tag == miNULLTAG || tag > tags.size() || tags[tag - 1].kind != kind)
+		return NULL;
+	return &tags[tag - 1];
+}
+
+void mr_mock_reset(void)
+{
+	miState state;
+	memset(&state, 0, sizeof(state));
+	state.options = &options;
+	for (size_t i = 0; i < shaders.size(); i++) {
+		if (shaders[i].exit != NULL) {
+			state.shader = &shaders[i];
+			shaders[i].exit(&state, NULL);
+			shaders[i].exit(&state, shaders[i].params);
+		}
+	}
+
+	tags.clear();
+	spheres.clear();
+	grounds.clear();
+	lights.clear();
+	shaders.clear();
+	connections.clear();
+	string_options.clear();
+
+	memset(&options, 0, sizeof(options));
+	options.shadow = 'o';
+	options.reflection_depth = 2;
+	options.refraction_depth = 2;
+	options.trace_depth = 4;
+	environment = black;
+	mr_mock_reset_stats();
+}
+
+miOptions *mr_mock_options(void)
+{
+	return &options;
+}
+
+void mr_mock_set_string_option(const char *name, const char *value)
+{
+	string_options[name] = value;
+}
+
+void mr_mock_set_environment(miColor c)
+{
+	environment = c;
+}
+
+void mr_mock_set_camera(miVector origin, miVector look_at, miScalar fov)
+{
+	camera_origin = origin;
+	camera_forward = normalize(sub(look_at, origin));
+	camera_right = normalize(cross(vec(0.f, 1.f, 0.f), camera_forward));
+	camera_up = cross(camera_forward, camera_right);
+	camera_tan = tanf(0.5f * fov);
+}
+
+miTag mr_mock_add_sphere(miVector center, miScalar radius, miColor diffuse)
+{
+	Sphere s = { center, radius, diffuse, miNULLTAG };
+	spheres.push_back(s);
+	return new_tag(TAG_SPHERE, (int)spheres.size() - 1);
+}
+
+miTag mr_mock_add_ground(miScalar height, miColor diffuse)
+{
+	Ground g = { height, diffuse, miNULLTAG };
+	grounds.push_back(g);
+	return new_tag(TAG_GROUND, (int)grounds.size() - 1);
+}
+
+miTag mr_mock_add_point_light(miVector origin, miColor c)
+{
+	Light l = { LIGHT_POINT, origin, vec(0.f, 0.f, 0.f), vec(0.f, 0.f, 0.f), vec(0.f, -1.f, 0.f), 0.f, c, 1 };
+	lights.push_back(l);
+	return new_tag(TAG_LIGHT, (int)lights.size() - 1);
+}
+
+miTag mr_mock_add_rectangle_light(miVector origin, miVector u, miVector v, miColor c, int samples)
+{
+	miVector n = cross(u, v);
+	Light l = { LIGHT_RECTANGLE, origin, u, v, normalize(n), sqrtf(dot(n, n)), c, samples > 0 ? samples : 1 };
+	lights.push_back(l);
+	return new_tag(TAG_LIGHT, (int)lights.size() - 1);
+}
+
+miTag mr_mock_add_shader(mr_mock_shader_fn shader, mr_mock_init_fn init, mr_mock_exit_fn exit, void *params)
+{
+	ShaderInstance instance = { shader, exit, params, NULL };
+	shaders.push_back(instance);
+	miTag tag = new_tag(TAG_SHADER, (int)shaders.size() - 1);
+
+	if (init != NULL) {
+		miState state;
+		miBoolean instance_init = miFALSE;
+		memset(&state, 0, sizeof(state));
+		state.options = &options;
+		state.shader = &shaders.back();
+		init(&state, NULL, &instance_init);
+		if (instance_init)
+			init(&state, params, &instance_init);
+	}
+	return tag;
+}
+
+void mr_mock_set_material(miTag object, miTag shader)
+{
+	const TagEntry *entry;
+	if ((entry = find_tag(object, TAG_SPHERE)) != NULL)
+		spheres[entry->index].material = shader;
+	else if ((entry = find_tag(object, TAG_GROUND)) != NULL)
+		grounds[entry->index].material = shader;
+}
+
+void mr_mock_connect(void *param, miTag shader)
+{
+	connections[param] = shader;
+}
+
+void mr_mock_get_stats(mr_mock_stats *s)
+{
+	*s = stats;
+}
+
+void mr_mock_reset_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+
+/* Intersection ------------------------------------------------------------ */
+
+struct Hit {
+	int			kind;
+	int			index;
+	miScalar	t;
+	miVector	normal;		/* outward */
+};
+
+static bool intersect_sphere(const Sphere &s, const miVector &org, const miVector &dir, miScalar t_max, miScalar *t, miVector *normal)
+{
+	miVector oc = sub(org, s.center);
+	miScalar b = dot(oc, dir), c = dot(oc, oc) - s.radius * s.radius;
+	miScalar disc = b * b - c;
+	if (disc < 0.f)
+		return false;
+
+	miScalar root = sqrtf(disc);
+	miScalar t0 = -b - root;
+	if (t0 <= MR_MOCK_EPSILON)
+		t0 = -b + root;
+	if (t0 <= MR_MOCK_EPSILON || t0 >= t_max)
+		return false;
+
+	*t = t0;
+	*normal = scale(sub(add(org, scale(dir, t0)), s.center), 1.f / s.radius);
+	return true;
+}
+
+static bool intersect_rectangle(const Light &l, const miVector &org, const miVector &dir, miScalar t_max, miScalar *t)
+{
+	miScalar cos_l = dot(dir, l.normal);
+	if (cos_l >= 0.f)
+		return false;
+
+	miScalar t0 = dot(sub(l.origin, org), l.normal) / cos_l;
+	if (t0 <= MR_MOCK_EPSILON || t0 >= t_max)
+		return false;
+
+	miVector d = sub(add(org, scale(dir, t0)), l.origin);
+	if (fabsf(dot(d, l.u)) > 0.5f * dot(l.u, l.u) || fabsf(dot(d, l.v)) > 0.5f * dot(l.v, l.v))
+		return false;
+
+	*t = t0;
+	return true;
+}
+
+/* Closest hit, visible lights included unless only occluders are wanted */
+static bool intersect(const miVector &org, const miVector &dir, miScalar t_max, bool with_lights, Hit *hit)
+{
+	miScalar t;
+	miVector normal;
+
+	hit->t = t_max;
+	hit->kind = -1;
+	for (size_t i = 0; i < spheres.size(); i++) {
+		if (intersect_sphere(spheres[i], org, dir, hit->t, &t, &normal)) {
+			hit->kind = TAG_SPHERE;
+			hit->index = (int)i;
+			hit->t = t;
+			hit->normal = normal;
+		}
+	}
+	for (size_t i = 0; i < grounds.size(); i++) {
+		if (dir.y != 0.f) {
+			t = (grounds[i].height - org.y) / dir.y;
+			if (t > MR_MOCK_EPSILON && t < hit->t) {
+				hit->kind = TAG_GROUND;
+				hit->index = (int)i;
+				hit->t = t;
+				hit->normal = vec(0.f, 1.f, 0.f);
+			}
+		}
+	}
+	for (size_t i = 0; with_lights && i < lights.size(); i++) {
+		if (lights[i].type == LIGHT_RECTANGLE && intersect_rectangle(lights[i], org, dir, hit->t, &t)) {
+			hit->kind = TAG_LIGHT;
+			hit->index = (int)i;
+			hit->t = t;
+			hit->normal = lights[i].normal;
+		}
+	}
+	return hit->kind >= 0;
+}
+
+
+/* Sampling ---------------------------------------------------------------- */
+
+/* An open mi_sample loop, identified by its counter */
+struct SampleLoop {
+	int			*instance;
+	uint32_t	seed;
+	int			current;
+};
+
+static thread_local std::vector<SampleLoop> sample_loops;
+static thread_local uint32_t eye_seed;
+static thread_local int trace_level;
+static thread_local uint64_t random_state = 0x9e3779b97f4a7c15ull;
+
+static inline uint32_t hash(uint32_t a, uint32_t b)
+{
+	uint32_t h = a * 0x85ebca6bu ^ (b + 0x9e3779b9u + (a << 6) + (a >> 2));
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	return h ^ (h >> 16);
+}
+
+static inline double to_unit(uint32_t h)
+{
+	return h * (1.0 / 4294967296.0);
+}
+
+static double radical_inverse(int base, uint32_t i)
+{
+	double inv_base = 1.0 / base, f = inv_base, r = 0.0;
+	for (; i > 0; i /= base, f *= inv_base)
+		r += f * (i % base);
+	return r;
+}
+
+static const int primes[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53 };
+
+/* Seed of a loop opened now: from the sample of the enclosing loop, or the
+   eye ray and trace level outside of any loop */
+static uint32_t enclosing_seed(void)
+{
+	if (sample_loops.empty())
+		return hash(eye_seed, (uint32_t)trace_level);
+
+	const SampleLoop &l = sample_loops.back();
+	return hash(l.seed, (uint32_t)l.current);
+}
+
+/* Drops the loops opened past depth that were never finished */
+static void close_sample_loops(size_t depth)
+{
+	if (sample_loops.size() > depth) {
+		stats.unfinished_sample_loops += sample_loops.size() - depth;
+		sample_loops.resize(depth);
+	}
+}
+
+extern "C" miBoolean mi_sample(double *sample, int *instance, miState *state, const miUint dimension, const miUint *n)
+{
+	if (*instance == 0) {
+		/* A counter reused before its loop finished */
+		if (!sample_loops.empty() && sample_loops.back().instance == instance)
+			close_sample_loops(sample_loops.size() - 1);
+
+		SampleLoop l = { instance, hash(enclosing_seed(), dimension), 0 };
+		sample_loops.push_back(l);
+		stats.sample_loops++;
+	}
+	else {
+		/* Loops opened inside this one that weren't finished */
+		size_t depth = sample_loops.size();
+		while (depth > 0 && sample_loops[depth - 1].instance != instance)
+			depth--;
+		if (depth == 0) {
+			mi_error("mi_sample: counter %d of an unknown loop", *instance);
+			return miFALSE;
+		}
+		close_sample_loops(depth);
+	}
+
+	SampleLoop &l = sample_loops.back();
+	if (*instance >= (int)*n) {
+		sample_loops.pop_back();
+		return miFALSE;
+	}
+
+	for (miUint d = 0; d < dimension; d++) {
+		double u = radical_inverse(primes[d % 16], (uint32_t)*instance) + to_unit(hash(l.seed, d));
+		sample[d] = u < 1.0 ? u : u - 1.0;
+	}
+	l.current = (*instance)++;
+	return miTRUE;
+}
+
+extern "C" double mi_random(void)
+{
+	random_state ^= random_state >> 12;
+	random_state ^= random_state << 25;
+	random_state ^= random_state >> 27;
+	return (double)((random_state * 0x2545f4914f6cdd1dull) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+/* Shading ----------------------------------------------------------------- */
+
+static thread_local miState child_states[MR_MOCK_MAX_DEPTH];
+static thread_local unsigned char eval_results[16][64];
+static thread_local int eval_next;
+
+static bool occluded(const miVector &org, const miVector &dir, miScalar dist)
+{
+	Hit hit;
+	stats.shadow_rays++;
+	return intersect(org, dir, dist * (1.f - MR_MOCK_EPSILON), false, &hit);
+}
+
+static miBoolean call_shader(void *result, miState *state, miTag shader, void *params)
+{
+	const TagEntry *entry = find_tag(shader, TAG_SHADER);
+	if (entry == NULL)
+		return miFALSE;
+
+	ShaderInstance &instance = shaders[entry->index];
+	void *caller = state->shader;
+	state->shader = &instance;
+	stats.shader_calls++;
+	miBoolean ok = instance.shader(result, state, params ? params : instance.params);
+	state->shader = caller;
+	return ok;
+}
+
+/* Lambert shading of objects without a material */
+static void shade_diffuse(miColor *result, miState *state, const miColor &diffuse)
+{
+	miColor sum = black, light_color;
+	miVector dir;
+	miScalar dot_nl;
+
+	mi_compute_avg_radiance(&sum, state, 'f', NULL);
+	for (size_t t = 0; t < tags.size(); t++) {
+		if (tags[t].kind != TAG_LIGHT)
+			continue;
+
+		int samples = 0;
+		miColor light_sum = black;
+		while (mi_sample_light(&light_color, &dir, &dot_nl, state, (miTag)(t + 1), &samples)) {
+			light_sum.r += light_color.r * dot_nl;
+			light_sum.g += light_color.g * dot_nl;
+			light_sum.b += light_color.b * dot_nl;
+		}
+		if (samples > 0) {
+			sum.r += light_sum.r / (samples * (miScalar)M_PI);
+			sum.g += light_sum.g / (samples * (miScalar)M_PI);
+			sum.b += light_sum.b / (samples * (miScalar)M_PI);
+		}
+	}
+
+	*result = color(sum.r * diffuse.r, sum.g * diffuse.g, sum.b * diffuse.b);
+}
+
+static void fill_hit(miState *state, const Hit &hit)
+{
+	state->dist = hit.t;
+	state->point = add(state->org, scale(state->dir, hit.t));
+	state->normal = hit.normal;
+	state->inv_normal = dot(hit.normal, state->dir) > 0.f;
+	if (state->inv_normal)
+		state->normal = scale(hit.normal, -1.f);
+	state->normal_geom = state->normal;
+	state->dot_nd = dot(state->normal, state->dir);
+	memset(state->derivs, 0, sizeof(state->derivs));
+	state->child = NULL;
+	state->shader = NULL;
+
+	if (hit.kind == TAG_SPHERE)
+		state->material = spheres[hit.index].material;
+	else if (hit.kind == TAG_GROUND)
+		state->material = grounds[hit.index].material;
+	else
+		state->material = miNULLTAG;
+}
+
+static miBoolean shade_hit(miColor *result, miState *state, const Hit &hit)
+{
+	if (hit.kind == TAG_LIGHT) {
+		*result = lights[hit.index].color;
+		result->a = 1.f;
+		return miTRUE;
+	}
+	if (state->material != miNULLTAG)
+		return call_shader(result, state, state->material, NULL);
+
+	shade_diffuse(result, state, hit.kind == TAG_SPHERE ? spheres[hit.index].diffuse : grounds[hit.index].diffuse);
+	return miTRUE;
+}
+
+static miBoolean trace(miColor *result, miState *state, miVector *dir, miRay_type type)
+{
+	*result = black;
+	if (trace_level + 1 >= MR_MOCK_MAX_DEPTH)
+		return miFALSE;
+
+	miState *child = &child_states[trace_level + 1];
+	*child = *state;
+	child->parent = state;
+	child->type = type;
+	child->org = state->point;
+	child->dir = normalize(*dir);
+	if (type == miRAY_REFLECT)
+		child->reflection_level++;
+	else
+		child->refraction_level++;
+	state->child = child;
+
+	Hit hit;
+	if (!intersect(child->org, child->dir, miHUGE_SCALAR, true, &hit)) {
+		child->dist = 0.0;
+		return miFALSE;
+	}
+
+	fill_hit(child, hit);
+
+	size_t loops = sample_loops.size();
+	trace_level++;
+	miBoolean ok = shade_hit(result, child, hit);
+	trace_level--;
+	close_sample_loops(loops);
+	return ok;
+}
+
+extern "C" miBoolean mi_trace_reflection(miColor *result, miState *state, miVector *dir)
+{
+	stats.reflection_rays++;
+	if (state->reflection_level >= options.reflection_depth ||
+		state->reflection_level + state->refraction_level >= options.trace_depth) {
+		*result = black;
+		return miFALSE;
+	}
+	return trace(result, state, dir, miRAY_REFLECT);
+}
+
+extern "C" miBoolean mi_trace_refraction(miColor *result, miState *state, miVector *dir)
+{
+	stats.refraction_rays++;
+	if (state->refraction_level >= options.refraction_depth ||
+		state->reflection_level + state->refraction_level >= options.trace_depth) {
+		*result = black;
+		return miFALSE;
+	}
+	return trace(result, state, dir, miRAY_REFRACT);
+}
+
+extern "C" miBoolean mi_trace_environment(miColor *result, miState *state, miVector *dir)
+{
+	stats.environment_rays++;
+	*result = environment;
+	return miTRUE;
+}
+
+extern "C" miBoolean mi_trace_transparent(miColor *result, miState *state)
+{
+	miVector dir = state->dir;
+	if (!trace(result, state, &dir, miRAY_TRANSPARENT))
+		*result = environment;
+	return miTRUE;
+}
+
+extern "C" miBoolean mi_trace_shadow(miColor *result, miState *state)
+{
+	return miTRUE;
+}
+
+extern "C" miBoolean mi_trace_probe(miState *state, const miVector *dir, const miVector *org)
+{
+	Hit hit;
+	miVector d = normalize(*dir);
+	if (!intersect(*org, d, miHUGE_SCALAR, false, &hit))
+		return miFALSE;
+
+	miState *child = &child_states[trace_level + 1 < MR_MOCK_MAX_DEPTH ? trace_level + 1 : trace_level];
+	*child = *state;
+	child->parent = state;
+	child->org = *org;
+	child->dir = d;
+	fill_hit(child, hit);
+	state->child = child;
+	return miTRUE;
+}
+
+extern "C" void mi_reflection_dir(miVector *dir, miState *state)
+{
+	*dir = sub(state->dir, scale(state->normal, 2.f * dot(state->dir, state->normal)));
+}
+
+extern "C" miBoolean mi_refraction_dir(miVector *dir, miState *state, miScalar ior_in, miScalar ior_out)
+{
+	miScalar eta = ior_in / ior_out;
+	miScalar cos_i = -dot(state->dir, state->normal);
+	miScalar k = 1.f - eta * eta * (1.f - cos_i * cos_i);
+	if (k < 0.f)
+		return miFALSE;
+
+	*dir = normalize(add(scale(state->dir, eta), scale(state->normal, eta * cos_i - sqrtf(k))));
+	return miTRUE;
+}
+
+extern "C" miBoolean mi_sample_light(miColor *result, miVector *dir, miScalar *dot_nl, miState *state, miTag light_inst, miInteger *samples)
+{
+	const TagEntry *entry = find_tag(light_inst, TAG_LIGHT);
+	if (entry == NULL)
+		return miFALSE;
+
+	const Light &l = lights[entry->index];
+	if (*samples >= (l.type == LIGHT_POINT ? 1 : l.samples))
+		return miFALSE;
+
+	miVector p = l.origin;
+	if (l.type == LIGHT_RECTANGLE) {
+		uint32_t seed = hash(hash(enclosing_seed(), light_inst), (uint32_t)(state->point.x * 4096.f) ^ (uint32_t)(state->point.z * 65536.f));
+		double s = radical_inverse(2, (uint32_t)*samples) + to_unit(hash(seed, 0));
+		double t = radical_inverse(3, (uint32_t)*samples) + to_unit(hash(seed, 1));
+		s -= s >= 1.0 ? 1.0 : 0.0;
+		t -= t >= 1.0 ? 1.0 : 0.0;
+		p = add(p, add(scale(l.u, (miScalar)s - 0.5f), scale(l.v, (miScalar)t - 0.5f)));
+	}
+	(*samples)++;
+	stats.light_samples++;
+
+	miVector d = sub(p, state->point);
+	miScalar dist2 = dot(d, d), dist = sqrtf(dist2);
+	*dir = scale(d, 1.f / dist);
+	*result = black;
+	/* Volume shaders pass no dot_nl, their points have no side to cull */
+	if (dot_nl != NULL) {
+		*dot_nl = dot(*dir, state->normal);
+		if (*dot_nl <= 0.f)
+			return miTRUE;
+	}
+
+	/* Rectangles return radiance over their solid angle pdf */
+	miScalar s = 1.f / dist2;
+	if (l.type == LIGHT_RECTANGLE) {
+		miScalar cos_l = -dot(*dir, l.normal);
+		if (cos_l <= 0.f)
+			return miTRUE;
+		s *= cos_l * l.area;
+	}
+
+	if (!occluded(state->point, *dir, dist))
+		*result = color(l.color.r * s, l.color.g * s, l.color.b * s);
+	return miTRUE;
+}
+
+/* No final gather, the environment reaches every point unoccluded */
+extern "C" miBoolean mi_compute_avg_radiance(miColor *result, miState *state, miUchar face, void *irrad_options)
+{
+	*result = environment;
+	return miTRUE;
+}
+
+
+/* Shaders, parameters and queries ----------------------------------------- */
+
+extern "C" void *mi_eval(miState *state, void *param)
+{
+	if (connections.empty())
+		return param;
+
+	std::unordered_map<void*, miTag>::const_iterator c = connections.find(param);
+	if (c == connections.end())
+		return param;
+
+	void *result = eval_results[eval_next++ & 15];
+	memset(result, 0, sizeof(eval_results[0]));
+	call_shader(result, state, c->second, NULL);
+	return result;
+}
+
+extern "C" miBoolean mi_call_shader(miColor *result, miShader_type type, miState *state, miTag shader)
+{
+	return call_shader(result, state, shader, NULL);
+}
+
+extern "C" miBoolean mi_call_shader_x(miColor *result, miShader_type type, miState *state, miTag shader, void *params)
+{
+	return call_shader(result, state, shader, params);
+}
+
+extern "C" miBoolean mi_query(miQ_type query, miState *state, miTag tag, void *result)
+{
+	const TagEntry *light = find_tag(tag, TAG_LIGHT);
+
+	switch (query) {
+	case miQ_FUNC_USERPTR:
+		if (state == NULL || state->shader == NULL)
+			return miFALSE;
+		*(void***)result = &((ShaderInstance*)state->shader)->user;
+		return miTRUE;
+	case miQ_INST_ITEM:
+		/* Instances are their items */
+		*(miTag*)result = tag;
+		return tag != miNULLTAG;
+	case miQ_INST_LOCAL_TO_GLOBAL:
+		return miFALSE;
+	case miQ_NUM_GLOBAL_LIGHTS: {
+		int count = 0;
+		for (size_t i = 0; i < tags.size(); i++)
+			count += tags[i].kind == TAG_LIGHT;
+		*(int*)result = count;
+		return miTRUE;
+	}
+	default:
+		break;
+	}
+
+	if (light == NULL)
+		return miFALSE;
+
+	const Light &l = lights[light->index];
+	switch (query) {
+	case miQ_LIGHT_AREA:
+		*(int*)result = l.type;
+		return miTRUE;
+	case miQ_LIGHT_ORIGIN:
+		*(miVector*)result = l.origin;
+		return miTRUE;
+	case miQ_LIGHT_DIRECTION:
+		*(miVector*)result = l.normal;
+		return miTRUE;
+	case miQ_LIGHT_SPREAD:
+		*(miScalar*)result = 0.f;
+		return miTRUE;
+	case miQ_LIGHT_AREA_R_EDGE_U:
+		*(miVector*)result = l.u;
+		return l.type == LIGHT_RECTANGLE;
+	case miQ_LIGHT_AREA_R_EDGE_V:
+		*(miVector*)result = l.v;
+		return l.type == LIGHT_RECTANGLE;
+	default:
+		return miFALSE;
+	}
+}
+
+extern "C" void *mi_db_access(miTag tag)
+{
+	static char empty[1] = "";
+	return empty;
+}
+
+extern "C" void mi_db_unpin(miTag tag)
+{
+}
+
+static miObject edited_object;
+
+extern "C" void *mi_scene_edit(miTag tag)
+{
+	return &edited_object;
+}
+
+extern "C" void mi_scene_edit_end(miTag tag)
+{
+}
+
+extern "C" miBoolean mi_geoshader_add_result(miTag *result, miTag tag)
+{
+	*result = tag;
+	return miTRUE;
+}
+
+extern "C" void mi_opacity_set(miState *state, miColor *opacity)
+{
+}
+
+extern "C" void mi_img_get_color(miImg_image *image, miColor *c, int x, int y)
+{
+	*c = black;
+}
+
+
+/* Memory and messages ----------------------------------------------------- */
+
+extern "C" void *mi_mem_allocate(int size)
+{
+	void *memory = calloc(1, size > 0 ? size : 1);
+	if (memory == NULL)
+		mi_fatal("mi_mem_allocate: out of memory (%d bytes)", size);
+	return memory;
+}
+
+extern "C" void mi_mem_release(void *memory)
+{
+	free(memory);
+}
+
+extern "C" char *mi_mem_strdup(const char *text)
+{
+	size_t size = strlen(text) + 1;
+	char *copy = (char*)mi_mem_allocate((int)size);
+	memcpy(copy, text, size);
+	return copy;
+}
+
+static void message(const char *kind, const char *format, va_list args)
+{
+	fprintf(stderr, "%s: ", kind);
+	vfprintf(stderr, format, args);
+	fputc('\n', stderr);
+}
+
+extern "C" void mi_fatal(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	message("fatal", format, args);
+	va_end(args);
+	abort();
+}
+
+extern "C" void mi_error(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	message("error", format, args);
+	va_end(args);
+}
+
+extern "C" void mi_warning(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	message("warning", format, args);
+	va_end(args);
+}
+
+/* Info and progress messages only with MR_MOCK_VERBOSE set */
+extern "C" void mi_info(const char *format, ...)
+{
+	static const bool verbose = getenv("MR_MOCK_VERBOSE") != NULL;
+	if (!verbose)
+		return;
+
+	va_list args;
+	va_start(args, format);
+	message("info", format, args);
+	va_end(args);
+}
+
+extern "C" void mi_progress(const char *format, ...)
+{
+	static const bool verbose = getenv("MR_MOCK_VERBOSE") != NULL;
+	if (!verbose)
+		return;
+
+	va_list args;
+	va_start(args, format);
+	message("progress", format, args);
+	va_end(args);
+}
+
+
+/* Spaces and matrices ----------------------------------------------------- */
+
+extern "C" void mi_point_to_world(miState *state, miVector *result, miVector *point) { *result = *point; }
+extern "C" void mi_point_from_world(miState *state, miVector *result, miVector *point) { *result = *point; }
+extern "C" void mi_vector_to_world(miState *state, miVector *result, miVector *vector) { *result = *vector; }
+extern "C" void mi_point_to_camera(miState *state, miVector *result, miVector *point) { *result = *point; }
+extern "C" void mi_point_from_camera(miState *state, miVector *result, miVector *point) { *result = *point; }
+extern "C" void mi_vector_to_camera(miState *state, miVector *result, miVector *vector) { *result = *vector; }
+extern "C" void mi_vector_from_camera(miState *state, miVector *result, miVector *vector) { *result = *vector; }
+extern "C" void mi_vector_to_light(miState *state, miVector *result, miVector *vector) { *result = *vector; }
+
+/* Row vectors, as in mental ray: p' = p * M */
+extern "C" void mi_point_transform(miVector *result, miVector *point, miMatrix m)
+{
+	miVector p = *point;
+	miScalar w = p.x * m[3] + p.y * m[7] + p.z * m[11] + m[15];
+	result->x = p.x * m[0] + p.y * m[4] + p.z * m[8] + m[12];
+	result->y = p.x * m[1] + p.y * m[5] + p.z * m[9] + m[13];
+	result->z = p.x * m[2] + p.y * m[6] + p.z * m[10] + m[14];
+	if (w != 0.f && w != 1.f)
+		mi_vector_mul(result, 1.f / w);
+}
+
+extern "C" void mi_vector_transform(miVector *result, miVector *vector, miMatrix m)
+{
+	miVector v = *vector;
+	result->x = v.x * m[0] + v.y * m[4] + v.z * m[8];
+	result->y = v.x * m[1] + v.y * m[5] + v.z * m[9];
+	result->z = v.x * m[2] + v.y * m[6] + v.z * m[10];
+}
+
+static void matrix_multiply(miMatrix result, const miMatrix a, const miMatrix b)
+{
+	miMatrix r;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			r[4 * i + j] = a[4 * i] * b[j] + a[4 * i + 1] * b[4 + j] + a[4 * i + 2] * b[8 + j] + a[4 * i + 3] * b[12 + j];
+	memcpy(result, r, sizeof(r));
+}
+
+/* Rotation about x, then y, then z */
+extern "C" void mi_matrix_rotate(miMatrix m, miScalar x, miScalar y, miScalar z)
+{
+	miScalar cx = cosf(x), sx = sinf(x), cy = cosf(y), sy = sinf(y), cz = cosf(z), sz = sinf(z);
+	miMatrix rx = { 1, 0, 0, 0,  0, cx, sx, 0,  0, -sx, cx, 0,  0, 0, 0, 1 };
+	miMatrix ry = { cy, 0, -sy, 0,  0, 1, 0, 0,  sy, 0, cy, 0,  0, 0, 0, 1 };
+	miMatrix rz = { cz, sz, 0, 0,  -sz, cz, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };
+	matrix_multiply(m, rx, ry);
+	matrix_multiply(m, m, rz);
+}
+
+extern "C" void mi_matrix_rotate_axis(miMatrix m, miVector *axis, miScalar angle)
+{
+	miVector a = normalize(*axis);
+	miScalar c = cosf(angle), s = sinf(angle), t = 1.f - c;
+	miMatrix r = {
+		t * a.x * a.x + c,			t * a.x * a.y + s * a.z,	t * a.x * a.z - s * a.y,	0,
+		t * a.x * a.y - s * a.z,	t * a.y * a.y + c,			t * a.y * a.z + s * a.x,	0,
+		t * a.x * a.z + s * a.y,	t * a.y * a.z - s * a.x,	t * a.z * a.z + c,			0,
+		0, 0, 0, 1
+	};
+	memcpy(m, r, sizeof(r));
+}
+
+
+/* Illumination models, close enough to mental ray's for timing ------------ */
+
+extern "C" miScalar mi_phong_specular(miScalar spec_exp, miState *state, miVector *dir)
+{
+	miVector r;
+	mi_reflection_dir(&r, state);
+	miScalar c = dot(r, *dir);
+	return c > 0.f ? powf(c, spec_exp) : 0.f;
+}
+
+extern "C" miScalar mi_blinn_specular(miVector *di, miVector *dr, miVector *n, miScalar roughness, miScalar ior)
+{
+	miVector h = normalize(sub(*dr, *di));
+	miScalar nh = dot(*n, h), nv = -dot(*n, *di), nl = dot(*n, *dr);
+	if (nh <= 0.f || nv <= 0.f || nl <= 0.f)
+		return 0.f;
+
+	miScalar m2 = roughness * roughness;
+	miScalar d = expf(-(1.f - nh * nh) / (nh * nh * m2)) / (m2 * nh * nh * nh * nh);
+	miScalar f0 = (ior - 1.f) * (ior - 1.f) / ((ior + 1.f) * (ior + 1.f));
+	miScalar f = f0 + (1.f - f0) * powf(1.f - dot(h, *dr), 5.f);
+	return d * f / (4.f * nv);
+}
+
+extern "C" miBoolean mi_cooktorr_specular(miColor *result, miVector *di, miVector *dr, miVector *n, miScalar roughness, miColor *ior)
+{
+	miScalar s = mi_blinn_specular(di, dr, n, roughness, 1.5f);
+	if (s <= 0.f) {
+		*result = black;
+		return miFALSE;
+	}
+
+	miVector h = normalize(sub(*dr, *di));
+	miScalar c = powf(1.f - dot(h, *dr), 5.f);
+	miScalar ch[3] = { ior->r, ior->g, ior->b }, out[3];
+	for (int i = 0; i < 3; i++) {
+		miScalar f0 = (ch[i] - 1.f) * (ch[i] - 1.f) / ((ch[i] + 1.f) * (ch[i] + 1.f));
+		out[i] = s * (f0 + (1.f - f0) * c) / 0.04f;
+	}
+	*result = color(out[0], out[1], out[2]);
+	return miTRUE;
+}
+
+extern "C" miScalar mi_ward_glossy(miVector *di, miVector *dr, miVector *n, miScalar shiny)
+{
+	miScalar cos_i = -dot(*n, *di), cos_r = dot(*n, *dr);
+	if (cos_i <= 0.f || cos_r <= 0.f || shiny <= 0.f)
+		return 0.f;
+
+	miVector h = normalize(sub(*dr, *di));
+	miScalar nh = dot(*n, h), a2 = 1.f / (shiny * shiny);
+	miScalar tan2 = (1.f - nh * nh) / (nh * nh);
+	return expf(-tan2 / a2) / (4.f * (miScalar)M_PI * a2 * sqrtf(cos_i * cos_r));
+}
+
+extern "C" miScalar mi_ward_anisglossy(miVector *di, miVector *dr, miVector *n, miVector *u, miVector *v, miScalar shiny_u, miScalar shiny_v)
+{
+	miScalar cos_i = -dot(*n, *di), cos_r = dot(*n, *dr);
+	if (cos_i <= 0.f || cos_r <= 0.f || shiny_u <= 0.f || shiny_v <= 0.f)
+		return 0.f;
+
+	miVector h = normalize(sub(*dr, *di));
+	miScalar nh = dot(*n, h), hu = dot(h, *u) * shiny_u, hv = dot(h, *v) * shiny_v;
+	return shiny_u * shiny_v * expf(-(hu * hu + hv * hv) / (nh * nh)) / (4.f * (miScalar)M_PI * sqrtf(cos_i * cos_r));
+}
+
+
+/* Perlin's original lattice gradient noise, mapped to [0, 1] -------------- */
+
+static struct NoiseTables {
+	int			perm[512];
+	miScalar	grad[256][3];
+
+	NoiseTables() {
+		uint32_t s = 12345u;
+		for (int i = 0; i < 256; i++) {
+			miVector g;
+			do {
+				s = s * 1664525u + 1013904223u;
+				g.x = (miScalar)((s >> 8) & 0xffff) / 32768.f - 1.f;
+				s = s * 1664525u + 1013904223u;
+				g.y = (miScalar)((s >> 8) & 0xffff) / 32768.f - 1.f;
+				s = s * 1664525u + 1013904223u;
+				g.z = (miScalar)((s >> 8) & 0xffff) / 32768.f - 1.f;
+			} while (dot(g, g) > 1.f || dot(g, g) < 1e-4f);
+			g = normalize(g);
+			grad[i][0] = g.x;
+			grad[i][1] = g.y;
+			grad[i][2] = g.z;
+			perm[i] = i;
+		}
+		for (int i = 255; i > 0; i--) {
+			s = s * 1664525u + 1013904223u;
+			int j = (int)((s >> 8) % (uint32_t)(i + 1)), t = perm[i];
+			perm[i] = perm[j];
+			perm[j] = t;
+		}
+		for (int i = 0; i < 256; i++)
+			perm[256 + i] = perm[i];
+	}
+} noise_tables;
+
+static inline miScalar noise_weight(miScalar t) { return t * t * (3.f - 2.f * t); }
+
+extern "C" miScalar mi_unoise_3d(miVector *p)
+{
+	int ix = (int)floorf(p->x), iy = (int)floorf(p->y), iz = (int)floorf(p->z);
+	miScalar fx = p->x - ix, fy = p->y - iy, fz = p->z - iz;
+	miScalar sum = 0.f;
+
+	for (int c = 0; c < 8; c++) {
+		int dx = c & 1, dy = c >> 1 & 1, dz = c >> 2;
+		int h = noise_tables.perm[noise_tables.perm[noise_tables.perm[(ix + dx) & 255] + ((iy + dy) & 255)] + ((iz + dz) & 255)];
+		const miScalar *g = noise_tables.grad[h];
+		miScalar rx = fx - dx, ry = fy - dy, rz = fz - dz;
+		miScalar w = (dx ? noise_weight(fx) : 1.f - noise_weight(fx)) *
+			(dy ? noise_weight(fy) : 1.f - noise_weight(fy)) *
+			(dz ? noise_weight(fz) : 1.f - noise_weight(fz));
+		sum += w * (g[0] * rx + g[1] * ry + g[2] * rz);
+	}
+	return 0.5f + 0.5f * sum;
+}
+
+
+/* String options ---------------------------------------------------------- */
+
+class MockOptions : public mi::shader::Options {
+public:
+	bool get(const char *name, const char **value) const {
+		std::map<std::string, std::string>::const_iterator o = string_options.find(name);
+		if (o == string_options.end())
+			return false;
+		*value = o->second.c_str();
+		return true;
+	}
+	bool get(const char *name, float *value) const {
+		const char *text;
+		if (!get(name, &text))
+			return false;
+		*value = strtof(text, NULL);
+		return true;
+	}
+	bool get(const char *name, bool *value) const {
+		const char *text;
+		if (!get(name, &text))
+			return false;
+		*value = strcmp(text, "on") == 0 || strcmp(text, "true") == 0 || strcmp(text, "1") == 0;
+		return true;
+	}
+	bool get(const char *name, int *value) const {
+		const char *text;
+		if (!get(name, &text))
+			return false;
+		*value = (int)strtol(text, NULL, 10);
+		return true;
+	}
+	void release() const {}
+};
+
+class MockInterface : public mi::shader::Interface {
+public:
+	mi::shader::Options *getOptions(miTag string_options) { return &options; }
+	void release() {}
+
+private:
+	MockOptions options;
+};
+
+mi::shader::Interface *mi_get_shader_interface(int version)
+{
+	static MockInterface iface;
+	return &iface;
+}
+
+
+/* Geometry API, the last object's arrays are kept ------------------------- */
+
+static miObject api_object;
+static std::vector<miScalar> api_hair_scalars;
+static std::vector<miGeoIndex> api_hair_indices;
+static miTag api_objects;
+
+extern "C" miObject *mi_api_object_begin(char *name)
+{
+	mi_mem_release(name);
+	memset(&api_object, 0, sizeof(api_object));
+	return &api_object;
+}
+
+extern "C" miTag mi_api_object_end(void)
+{
+	return ++api_objects;
+}
+
+extern "C" miBoolean mi_api_object_file(char *filename)
+{
+	mi_mem_release(filename);
+	return miTRUE;
+}
+
+extern "C" miBoolean mi_api_object_callback(miApi_object_callback callback, void *data)
+{
+	return miTRUE;
+}
+
+extern "C" miBoolean mi_api_vector_xyz_add(miVector *v) { return miTRUE; }
+extern "C" miBoolean mi_api_vertex_add(int index) { return miTRUE; }
+extern "C" miBoolean mi_api_poly_begin_tag(int type, miTag material) { return miTRUE; }
+extern "C" miBoolean mi_api_poly_index_add(int index) { return miTRUE; }
+extern "C" miBoolean mi_api_poly_end(void) { return miTRUE; }
+extern "C" miBoolean mi_api_hair_info(int index, char type, int count) { return miTRUE; }
+
+extern "C" miScalar *mi_api_hair_scalars_begin(int count)
+{
+	api_hair_scalars.assign(count > 0 ? count : 0, 0.f);
+	return api_hair_scalars.data();
+}
+
+extern "C" miBoolean mi_api_hair_scalars_end(int count)
+{
+	return count == (int)api_hair_scalars.size();
+}
+
+extern "C" miGeoIndex *mi_api_hair_hairs_begin(int count)
+{
+	api_hair_indices.assign(count > 0 ? count : 0, 0);
+	return api_hair_indices.data();
+}
+
+extern "C" miBoolean mi_api_hair_hairs_end(void)
+{
+	return miTRUE;
+}
+
+
+/* Eye rays ---------------------------------------------------------------- */
+
+static thread_local miState eye_state;
+
+miBoolean mr_mock_eye_state(miState *state, double x, double y, unsigned pixel)
+{
+	/* Whatever the last eye ray's shader left open */
+	close_sample_loops(0);
+	trace_level = 0;
+	eye_seed = hash(pixel, 0x5eed5eedu);
+	stats.eye_rays++;
+
+	memset(state, 0, sizeof(*state));
+	state->options = &options;
+	state->type = miRAY_EYE;
+	state->org = camera_origin;
+	state->dir = normalize(add(camera_forward,
+		add(scale(camera_right, (miScalar)(2.0 * x - 1.0) * camera_tan),
+			scale(camera_up, (miScalar)(1.0 - 2.0 * y) * camera_tan))));
+	state->ior = state->ior_in = 1.f;
+	state->raster_x = x;
+	state->raster_y = y;
+	state->importance = 1.f;
+
+	Hit hit;
+	if (!intersect(state->org, state->dir, miHUGE_SCALAR, true, &hit))
+		return miFALSE;
+
+	fill_hit(state, hit);
+	child_states[0] = *state;
+	return miTRUE;
+}
+
+miBoolean mr_mock_trace_eye(miColor *result, double x, double y, unsigned pixel)
+{
+	if (!mr_mock_eye_state(&eye_state, x, y, pixel)) {
+		*result = environment;
+		return miFALSE;
+	}
+
+	Hit hit;
+	intersect(eye_state.org, eye_state.dir, miHUGE_SCALAR, true, &hit);
+	miBoolean ok = shade_hit(result, &eye_state, hit);
+	close_sample_loops(0);
+	return ok;
+}
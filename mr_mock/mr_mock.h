@@ -0,0 +1,77 @@
+/*
+   Stand-in mental ray runtime for building and benchmarking the shaders
+   without a mental ray license
+
+   shader.h, geoshader.h and mi_shader_if.h in this directory replace the
+   devkit headers. The runtime renders a small analytic scene: spheres,
+   ground planes and visible rectangle lights, a constant environment, and
+   point or rectangle lights. Traced rays call the material shader of the
+   object they hit (a built-in Lambert shader unless one is set), so the
+   shaders recurse as they would in a render, down to the depths set in the
+   options.
+
+   mi_sample hands out scrambled Halton points. Each sample loop is seeded
+   from the sample of the enclosing loop it is traced from, so rays have to
+   be traced inside the loop for their children to be decorrelated, as in
+   mental ray. Loops that are left before mi_sample returns miFALSE are
+   counted in mr_mock_stats::unfinished_sample_loops.
+
+   The scene, the shader instances and the counters are global and not
+   locked, the driver sets them up and renders from one thread.
+*/
+
+#ifndef MR_MOCK_H
+#define MR_MOCK_H
+
+#include "shader.h"
+
+typedef miBoolean (*mr_mock_shader_fn)(void *result, miState *state, void *params);
+typedef miBoolean (*mr_mock_init_fn)(miState *state, void *params, miBoolean *instance_init_required);
+typedef miBoolean (*mr_mock_exit_fn)(miState *state, void *params);
+
+typedef struct mr_mock_stats {
+	unsigned long long	eye_rays;
+	unsigned long long	reflection_rays;
+	unsigned long long	refraction_rays;
+	unsigned long long	environment_rays;
+	unsigned long long	shadow_rays;
+	unsigned long long	light_samples;
+	unsigned long long	shader_calls;
+	unsigned long long	sample_loops;
+	unsigned long long	unfinished_sample_loops;
+} mr_mock_stats;
+
+/* Clears the scene, the shader instances (calling their exit functions),
+   the string options and the counters. The options are reset to
+   reflection and refraction depth 2 and trace depth 4. */
+void mr_mock_reset(void);
+miOptions *mr_mock_options(void);
+void mr_mock_set_string_option(const char *name, const char *value);
+
+/* Scene, every function returns the tag of what it added */
+void mr_mock_set_environment(miColor color);
+void mr_mock_set_camera(miVector origin, miVector look_at, miScalar fov);
+miTag mr_mock_add_sphere(miVector center, miScalar radius, miColor diffuse);
+miTag mr_mock_add_ground(miScalar height, miColor diffuse);
+miTag mr_mock_add_point_light(miVector origin, miColor color);
+/* Rectangle centered on origin with edges u and v, facing u x v. It emits
+   color per unit area and is also hit by traced rays. */
+miTag mr_mock_add_rectangle_light(miVector origin, miVector u, miVector v, miColor color, int samples);
+
+/* Shader instances. init is called for the shader and the instance, exit
+   by mr_mock_reset, either can be NULL. params must stay valid. */
+miTag mr_mock_add_shader(mr_mock_shader_fn shader, mr_mock_init_fn init, mr_mock_exit_fn exit, void *params);
+void mr_mock_set_material(miTag object, miTag shader);
+/* mi_eval of param calls shader, whose result must fit in 64 bytes */
+void mr_mock_connect(void *param, miTag shader);
+
+/* Fills in state for the eye ray through raster position x, y in [0, 1),
+   returns miFALSE if it misses the scene. pixel seeds the samplers. */
+miBoolean mr_mock_eye_state(miState *state, double x, double y, unsigned pixel);
+/* Traces an eye ray and calls the material of the object it hits */
+miBoolean mr_mock_trace_eye(miColor *result, double x, double y, unsigned pixel);
+
+void mr_mock_get_stats(mr_mock_stats *stats);
+void mr_mock_reset_stats(void);
+
+#endif
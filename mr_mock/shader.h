@@ -0,0 +1,247 @@
+/*
+   Stand-in for the mental ray shader.h, see mr_mock.h
+
+   Declares the subset of the mental ray shader API the shaders in this
+   repository use, with the devkit's names and signatures, so the sources
+   build unchanged against either. The implementation in mr_mock.cpp runs
+   it against a small analytic scene.
+*/
+
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <math.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT __attribute__((visibility("default")))
+#endif
+
+typedef int				miBoolean;
+typedef int				miInteger;
+typedef unsigned int	miUint;
+typedef unsigned char	miUchar;
+typedef float			miScalar;
+typedef unsigned int	miTag;
+typedef int				miGeoIndex;
+typedef miScalar		miMatrix[16];
+
+#define miTRUE			1
+#define miFALSE			0
+#define miNULLTAG		0
+#define miHUGE_SCALAR	1e36f
+
+typedef struct miVector {
+	miScalar	x, y, z;
+} miVector;
+
+typedef struct miColor {
+	miScalar	r, g, b, a;
+} miColor;
+
+typedef enum {
+	miRAY_EYE,
+	miRAY_TRANSPARENT,
+	miRAY_REFRACT,
+	miRAY_REFLECT,
+	miRAY_SHADOW,
+	miRAY_LIGHT,
+	miRAY_ENVIRONMENT,
+	miRAY_FINALGATHER
+} miRay_type;
+
+typedef enum {
+	miSHADER_MATERIAL,
+	miSHADER_TEXTURE,
+	miSHADER_LIGHT,
+	miSHADER_SHADOW,
+	miSHADER_ENVIRONMENT,
+	miSHADER_VOLUME
+} miShader_type;
+
+typedef enum {
+	miQ_FUNC_USERPTR,
+	miQ_INST_ITEM,
+	miQ_INST_LOCAL_TO_GLOBAL,
+	miQ_NUM_GLOBAL_LIGHTS,
+	miQ_LIGHT_ORIGIN,
+	miQ_LIGHT_DIRECTION,
+	miQ_LIGHT_SPREAD,
+	miQ_LIGHT_AREA,
+	miQ_LIGHT_AREA_R_EDGE_U,
+	miQ_LIGHT_AREA_R_EDGE_V,
+	miQ_LIGHT_AREA_D_NORMAL,
+	miQ_LIGHT_AREA_D_RADIUS
+} miQ_type;
+
+typedef struct miOptions {
+	char		shadow;
+	int			reflection_depth;
+	int			refraction_depth;
+	int			trace_depth;
+	miTag		string_options;
+} miOptions;
+
+typedef struct miState {
+	struct miState	*parent;
+	struct miState	*child;
+	miOptions		*options;
+	miRay_type		type;
+	int				reflection_level;
+	int				refraction_level;
+	miVector		org;
+	miVector		dir;
+	double			dist;
+	miVector		point;
+	miVector		normal;
+	miVector		normal_geom;
+	miScalar		dot_nd;
+	miBoolean		inv_normal;
+	miVector		derivs[5];
+	miScalar		ior;
+	miScalar		ior_in;
+	miTag			material;
+	miTag			instance;
+	miTag			light_instance;
+	void			*shader;		/* the shader instance being called */
+	int				thread;
+	double			raster_x;
+	double			raster_y;
+	miScalar		importance;
+} miState;
+
+#define miOBJECT_HAIR		3
+
+typedef struct miObject {
+	miVector	bbox_min, bbox_max;
+	int			type;
+	miBoolean	visible, reflection, refraction;
+	int			shadow;
+	struct {
+		int		type;
+		miTag	hair_list;
+		struct {
+			int	type;
+		} placeholder_list;
+	} geo;
+} miObject;
+
+typedef struct miImg_image {
+	int		width, height;
+} miImg_image;
+
+typedef miBoolean (*miApi_object_callback)(miTag, void*);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Parameters, shaders can be attached to any of them, see mr_mock_connect */
+void *mi_eval(miState *state, void *param);
+
+#define mi_eval_boolean(p)		((miBoolean *)mi_eval(state, (void *)(p)))
+#define mi_eval_integer(p)		((miInteger *)mi_eval(state, (void *)(p)))
+#define mi_eval_scalar(p)		((miScalar *)mi_eval(state, (void *)(p)))
+#define mi_eval_vector(p)		((miVector *)mi_eval(state, (void *)(p)))
+#define mi_eval_color(p)		((miColor *)mi_eval(state, (void *)(p)))
+#define mi_eval_transform(p)	((miScalar *)mi_eval(state, (void *)(p)))
+#define mi_eval_tag(p)			((miTag *)mi_eval(state, (void *)(p)))
+
+/* Ray tracing */
+miBoolean mi_trace_reflection(miColor *result, miState *state, miVector *dir);
+miBoolean mi_trace_refraction(miColor *result, miState *state, miVector *dir);
+miBoolean mi_trace_environment(miColor *result, miState *state, miVector *dir);
+miBoolean mi_trace_transparent(miColor *result, miState *state);
+miBoolean mi_trace_shadow(miColor *result, miState *state);
+miBoolean mi_trace_probe(miState *state, const miVector *dir, const miVector *org);
+void mi_reflection_dir(miVector *dir, miState *state);
+miBoolean mi_refraction_dir(miVector *dir, miState *state, miScalar ior_in, miScalar ior_out);
+
+/* Sampling and lights */
+miBoolean mi_sample(double *sample, int *instance, miState *state, const miUint dimension, const miUint *n);
+miBoolean mi_sample_light(miColor *result, miVector *dir, miScalar *dot_nl, miState *state, miTag light_inst, miInteger *samples);
+miBoolean mi_compute_avg_radiance(miColor *result, miState *state, miUchar face, void *irrad_options);
+double mi_random(void);
+miScalar mi_unoise_3d(miVector *point);
+
+/* Shaders and the database */
+miBoolean mi_call_shader(miColor *result, miShader_type type, miState *state, miTag shader);
+miBoolean mi_call_shader_x(miColor *result, miShader_type type, miState *state, miTag shader, void *params);
+miBoolean mi_query(miQ_type query, miState *state, miTag tag, void *result);
+void *mi_db_access(miTag tag);
+void mi_db_unpin(miTag tag);
+void *mi_scene_edit(miTag tag);
+void mi_scene_edit_end(miTag tag);
+miBoolean mi_geoshader_add_result(miTag *result, miTag tag);
+void mi_opacity_set(miState *state, miColor *opacity);
+void mi_img_get_color(miImg_image *image, miColor *color, int x, int y);
+
+/* Memory and messages */
+void *mi_mem_allocate(int size);
+void mi_mem_release(void *memory);
+char *mi_mem_strdup(const char *text);
+void mi_fatal(const char *message, ...);
+void mi_error(const char *message, ...);
+void mi_warning(const char *message, ...);
+void mi_info(const char *message, ...);
+void mi_progress(const char *message, ...);
+
+/* Spaces, internal space is world space and camera space in the mock */
+void mi_point_to_world(miState *state, miVector *result, miVector *point);
+void mi_point_from_world(miState *state, miVector *result, miVector *point);
+void mi_vector_to_world(miState *state, miVector *result, miVector *vector);
+void mi_point_to_camera(miState *state, miVector *result, miVector *point);
+void mi_point_from_camera(miState *state, miVector *result, miVector *point);
+void mi_vector_to_camera(miState *state, miVector *result, miVector *vector);
+void mi_vector_from_camera(miState *state, miVector *result, miVector *vector);
+void mi_vector_to_light(miState *state, miVector *result, miVector *vector);
+void mi_point_transform(miVector *result, miVector *point, miMatrix matrix);
+void mi_vector_transform(miVector *result, miVector *vector, miMatrix matrix);
+void mi_matrix_rotate(miMatrix matrix, miScalar x, miScalar y, miScalar z);
+void mi_matrix_rotate_axis(miMatrix matrix, miVector *axis, miScalar angle);
+
+/* Built-in illumination models */
+miScalar mi_phong_specular(miScalar spec_exp, miState *state, miVector *dir);
+miScalar mi_blinn_specular(miVector *di, miVector *dr, miVector *n, miScalar roughness, miScalar ior);
+miBoolean mi_cooktorr_specular(miColor *result, miVector *di, miVector *dr, miVector *n, miScalar roughness, miColor *ior);
+miScalar mi_ward_glossy(miVector *di, miVector *dr, miVector *n, miScalar shiny);
+miScalar mi_ward_anisglossy(miVector *di, miVector *dr, miVector *n, miVector *u, miVector *v, miScalar shiny_u, miScalar shiny_v);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* Vector helpers, macros in the devkit */
+inline void mi_vector_add(miVector *r, const miVector *a, const miVector *b) { r->x = a->x + b->x; r->y = a->y + b->y; r->z = a->z + b->z; }
+inline void mi_vector_sub(miVector *r, const miVector *a, const miVector *b) { r->x = a->x - b->x; r->y = a->y - b->y; r->z = a->z - b->z; }
+inline void mi_vector_mul(miVector *r, miScalar f) { r->x *= f; r->y *= f; r->z *= f; }
+inline miScalar mi_vector_dot(const miVector *a, const miVector *b) { return a->x * b->x + a->y * b->y + a->z * b->z; }
+inline void mi_vector_prod(miVector *r, const miVector *a, const miVector *b)
+{
+	miScalar x = a->y * b->z - a->z * b->y, y = a->z * b->x - a->x * b->z, z = a->x * b->y - a->y * b->x;
+	r->x = x; r->y = y; r->z = z;
+}
+inline miScalar mi_vector_norm(const miVector *v) { return sqrtf(mi_vector_dot(v, v)); }
+inline void mi_vector_normalize(miVector *v)
+{
+	miScalar l = mi_vector_norm(v);
+	if (l != 0.f)
+		mi_vector_mul(v, 1.f / l);
+}
+inline miScalar mi_vector_dist(const miVector *a, const miVector *b)
+{
+	miVector d = { a->x - b->x, a->y - b->y, a->z - b->z };
+	return mi_vector_norm(&d);
+}
+inline void mi_vector_min(miVector *r, const miVector *a, const miVector *b)
+{
+	r->x = a->x < b->x ? a->x : b->x; r->y = a->y < b->y ? a->y : b->y; r->z = a->z < b->z ? a->z : b->z;
+}
+inline void mi_vector_max(miVector *r, const miVector *a, const miVector *b)
+{
+	r->x = a->x > b->x ? a->x : b->x; r->y = a->y > b->y ? a->y : b->y; r->z = a->z > b->z ? a->z : b->z;
+}
+
+#endif
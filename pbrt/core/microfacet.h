@@ -60,6 +60,14 @@ class MicrofacetDistribution {
     }
     virtual Vector3f Sample_wh(const Vector3f &wo, const Point2f &u) const = 0;
     Float Pdf(const Vector3f &wo, const Vector3f &wh) const;
+    // Pdf() with D(wh) and G1(wo) already known, for batched sampling
+    Float Pdf(const Vector3f &wo, const Vector3f &wh, Float Dwh,
+              Float G1wo) const {
+        if (sampleVisibleArea)
+            return Dwh * G1wo * AbsDot(wo, wh) / std::abs(wo.z);
+        else
+            return Dwh * std::abs(wh.z);
+    }
     virtual std::string ToString() const = 0;
 
   protected:
@@ -100,21 +108,21 @@ class BeckmannDistribution : public MicrofacetDistribution {
     const Float alphax, alphay;
 };
 
-class TrowbridgeReitzDistribution : public MicrofacetDistribution {
+class TrowbridgeReitzDistribution final : public MicrofacetDistribution {
   public:
     // TrowbridgeReitzDistribution Public Methods
     static inline Float RoughnessToAlpha(Float roughness);
     TrowbridgeReitzDistribution(Float alphax, Float alphay,
                                 bool samplevis = true)
         : MicrofacetDistribution(samplevis), alphax(alphax), alphay(alphay) {}
-    Float D(const Vector3f &wh) const;
+    // D() and Lambda() are defined inline in reflection.h, next to the
+    // spherical coordinate helpers they use
+    inline Float D(const Vector3f &wh) const;
+    inline Float Lambda(const Vector3f &w) const;
     Vector3f Sample_wh(const Vector3f &wo, const Point2f &u) const;
     std::string ToString() const;
 
   private:
-    // TrowbridgeReitzDistribution Private Methods
-    Float Lambda(const Vector3f &w) const;
-
     // TrowbridgeReitzDistribution Private Data
     const Float alphax, alphay;
 };
@@ -243,6 +243,16 @@ inline double BitsToFloat(uint64_t ui) {
     return f;
 }
 
+inline uint64_t MixBits(uint64_t v) {
+    // 64-bit finalizer of MurmurHash3 / SplitMix64
+    v ^= (v >> 31);
+    v *= 0x7fb5d329728ea185ull;
+    v ^= (v >> 27);
+    v *= 0x81dadef4bc2dd44dull;
+    v ^= (v >> 33);
+    return v;
+}
+
 inline float NextFloatUp(float v) {
     // Handle infinity and negative zero for _NextFloatUp()_
     if (std::isinf(v) && v > 0.) return v;
@@ -47,56 +47,6 @@
 
 namespace pbrt {
 
-// BxDF Utility Functions
-miScalar FrDielectric(miScalar cosThetaI, miScalar etaI, miScalar etaT) {
-    cosThetaI = Clamp(cosThetaI, -1, 1);
-    // Potentially swap indices of refraction
-    bool entering = cosThetaI > 0.f;
-    if (!entering) {
-        std::swap(etaI, etaT);
-        cosThetaI = std::abs(cosThetaI);
-    }
-
-    // Compute _cosThetaT_ using Snell's law
-    miScalar sinThetaI = std::sqrt(std::max((miScalar)0, 1 - cosThetaI * cosThetaI));
-    miScalar sinThetaT = etaI / etaT * sinThetaI;
-
-    // Handle total internal reflection
-    if (sinThetaT >= 1) return 1;
-    miScalar cosThetaT = std::sqrt(std::max((miScalar)0, 1 - sinThetaT * sinThetaT));
-    miScalar Rparl = ((etaT * cosThetaI) - (etaI * cosThetaT)) /
-                  ((etaT * cosThetaI) + (etaI * cosThetaT));
-    miScalar Rperp = ((etaI * cosThetaI) - (etaT * cosThetaT)) /
-                  ((etaI * cosThetaI) + (etaT * cosThetaT));
-    return (Rparl * Rparl + Rperp * Rperp) / 2;
-}
-
-// https://seblagarde.wordpress.com/2013/04/29/memo-on-fresnel-equations/
-miColor FrConductor(miScalar cosThetaI, const miColor &etai,
-                     const miColor &etat, const miColor &k) {
-    cosThetaI = Clamp(cosThetaI, -1, 1);
-    miColor eta = etat / etai;
-    miColor etak = k / etai;
-
-    miScalar cosThetaI2 = cosThetaI * cosThetaI;
-    miScalar sinThetaI2 = 1. - cosThetaI2;
-    miColor eta2 = eta * eta;
-    miColor etak2 = etak * etak;
-
-    miColor t0 = eta2 - etak2 - sinThetaI2;
-    miColor a2plusb2 = Sqrt(t0 * t0 + 4 * eta2 * etak2);
-    miColor t1 = a2plusb2 + cosThetaI2;
-    miColor a = Sqrt(0.5f * (a2plusb2 + t0));
-    miColor t2 = (miScalar)2 * cosThetaI * a;
-    miColor Rs = (t1 - t2) / (t1 + t2);
-
-    miColor t3 = cosThetaI2 * a2plusb2 + sinThetaI2 * sinThetaI2;
-    miColor t4 = t2 * sinThetaI2;
-    miColor Rp = Rs * (t3 - t4) / (t3 + t4);
-
-    return (miScalar)0.5 * (Rp + Rs);
-}
-
 // BxDF Method Definitions
 miColor ScaledBxDF::f(const Vector3f &wo, const Vector3f &wi) const {
     return scale * bxdf->f(wo, wi);
@@ -118,23 +68,65 @@ std::string ScaledBxDF::ToString() const {
            std::string(" scale: ") + MiToString(scale) + std::string(" ]");
 }
 
-Fresnel::~Fresnel() {}
-miColor FresnelConductor::Evaluate(miScalar cosThetaI) const {
+// FresnelTable Method Definitions
+template <typename Func>
+void FresnelTable::Build(Func fr) {
+    const miScalar delta = 1.f / (nEntries - 1);
+    for (int i = 0; i < nEntries; ++i) values[i] = fr(cosMin + i * delta);
+
+    // Measure the interpolation error between neighbouring entries
+    maxError = 0;
+    for (int i = 0; i < nEntries - 1; ++i) {
+        for (miScalar t : {0.25f, 0.5f, 0.75f}) {
+            miScalar cosThetaI = cosMin + (i + t) * delta;
+            miColor d = Abs(Lookup(cosThetaI) - fr(cosThetaI));
+            maxError = std::max(maxError, std::max(d.r, std::max(d.g, d.b)));
+        }
+    }
+}
 
-    return FrConductor(std::abs(cosThetaI), etaI, etaT, k);
+void FresnelTable::InitDielectric(miScalar etaI, miScalar etaT) {
+    conductor = false;
+    // Total internal reflection happens on the side where light leaves the
+    // denser medium
+    cosMin = etaI <= etaT ? 0.f : -1.f;
+    this->etaI = {etaI, etaI, etaI, 1.f};
+    this->etaT = {etaT, etaT, etaT, 1.f};
+    this->k = BLA;
+    Build([=](miScalar cosThetaI) {
+        miScalar v = FrDielectric(cosThetaI, etaI, etaT);
+        return miColor{v, v, v, 1.f};
+    });
+}
+
+void FresnelTable::InitConductor(const miColor &etaI, const miColor &etaT,
+                                 const miColor &k) {
+    conductor = true;
+    cosMin = 0.f;
+    this->etaI = etaI;
+    this->etaT = etaT;
+    this->k = k;
+    Build([&](miScalar cosThetaI) {
+        return FrConductor(std::abs(cosThetaI), etaI, etaT, k);
+    });
+}
+
+bool FresnelTable::MatchesConductor(const miColor &etaI, const miColor &etaT,
+                                    const miColor &k) const {
+    auto same = [](const miColor &a, const miColor &b) {
+        return a.r == b.r && a.g == b.g && a.b == b.b;
+    };
+    return conductor && same(this->etaI, etaI) && same(this->etaT, etaT) &&
+           same(this->k, k);
 }
 
+Fresnel::~Fresnel() {}
 std::string FresnelConductor::ToString() const {
     return std::string("[ FresnelConductor etaI: ") + MiToString(etaI) +
            std::string(" etaT: ") + MiToString(etaT) + std::string(" k: ") +
            MiToString(k) + std::string(" ]");
 }
 
-miColor FresnelDielectric::Evaluate(miScalar cosThetaI) const {
-	miScalar v = FrDielectric(cosThetaI, etaI, etaT);
-	return { v, v, v, 1.0 };
-}
-
 std::string FresnelDielectric::ToString() const {
     return StringPrintf("[ FrenselDielectric etaI: %f etaT: %f ]", etaI, etaT);
 }
@@ -224,61 +216,47 @@ miColor OrenNayar::f(const Vector3f &wo, const Vector3f &wi) const {
     return R * InvPi * (A + B * maxCos * sinAlpha * tanBeta);
 }
 
+void OrenNayar::f_batch(const Vector3f &wo, int nSamples, const Vector3f *wi,
+                        miColor *f) const {
+    // Terms that only depend on _wo_ are shared by every direction
+    miScalar sinThetaO = SinTheta(wo), absCosThetaO = AbsCosTheta(wo);
+    miScalar sinPhiO = SinPhi(wo), cosPhiO = CosPhi(wo);
+    miColor RInvPi = R * InvPi;
+
+    for (int i = 0; i < nSamples; ++i) {
+        miScalar sinThetaI = SinTheta(wi[i]);
+        // Compute cosine term of Oren-Nayar model
+        miScalar maxCos = 0;
+        if (sinThetaI > 1e-4 && sinThetaO > 1e-4) {
+            miScalar dCos = CosPhi(wi[i]) * cosPhiO + SinPhi(wi[i]) * sinPhiO;
+            maxCos = std::max((miScalar)0, dCos);
+        }
+
+        // Compute sine and tangent terms of Oren-Nayar model
+        miScalar sinAlpha, tanBeta, absCosThetaI = AbsCosTheta(wi[i]);
+        if (absCosThetaI > absCosThetaO) {
+            sinAlpha = sinThetaO;
+            tanBeta = sinThetaI / absCosThetaI;
+        } else {
+            sinAlpha = sinThetaI;
+            tanBeta = sinThetaO / absCosThetaO;
+        }
+        f[i] = RInvPi * (A + B * maxCos * sinAlpha * tanBeta);
+    }
+}
+
 std::string OrenNayar::ToString() const {
     return std::string("[ OrenNayar R: ") + MiToString(R) +
            StringPrintf(" A: %f B: %f ]", A, B);
 }
 
-miColor MicrofacetReflection::f(const Vector3f &wo, const Vector3f &wi) const {
-    miScalar cosThetaO = AbsCosTheta(wo), cosThetaI = AbsCosTheta(wi);
-    Vector3f wh = wi + wo;
-    // Handle degenerate cases for microfacet reflection
-    if (cosThetaI == 0 || cosThetaO == 0) return BLA;
-    if (wh.x == 0 && wh.y == 0 && wh.z == 0) return BLA;
-    wh = Normalize(wh);
-    miColor F = fresnel->Evaluate(Dot(wi, wh));
-    return R * distribution->D(wh) * distribution->G(wo, wi) * F /
-           (4 * cosThetaI * cosThetaO);
-}
-
 std::string MicrofacetReflection::ToString() const {
-    return std::string("[ MicrofacetReflection R: ") + MiToString(R) +
-           std::string(" distribution: ") + distribution->ToString() +
-           std::string(" fresnel: ") + fresnel->ToString() + std::string(" ]");
-}
-
-miColor MicrofacetTransmission::f(const Vector3f &wo,
-                                   const Vector3f &wi) const {
-    if (SameHemisphere(wo, wi)) return BLA;  // transmission only
-
-    miScalar cosThetaO = CosTheta(wo);
-    miScalar cosThetaI = CosTheta(wi);
-    if (cosThetaI == 0 || cosThetaO == 0) return BLA;
-
-    // Compute $\wh$ from $\wo$ and $\wi$ for microfacet transmission
-    miScalar eta = CosTheta(wo) > 0 ? (etaB / etaA) : (etaA / etaB);
-    Vector3f wh = Normalize(wo + wi * eta);
-    if (wh.z < 0) wh = -wh;
-
-    miColor F = fresnel.Evaluate(Dot(wo, wh));
-
-    miScalar sqrtDenom = Dot(wo, wh) + eta * Dot(wi, wh);
-    miScalar factor = (mode == TransportMode::Radiance) ? (1 / eta) : 1;
-
-    return (WHI - F) * T *
-           std::abs(distribution->D(wh) * distribution->G(wo, wi) * eta * eta *
-                    AbsDot(wi, wh) * AbsDot(wo, wh) * factor * factor /
-                    (cosThetaI * cosThetaO * sqrtDenom * sqrtDenom));
+    return std::string("[ MicrofacetReflection lobe: ") + lobe.ToString() +
+           std::string(" ]");
 }
 
 std::string MicrofacetTransmission::ToString() const {
-    return std::string("[ MicrofacetTransmission T: ") + MiToString(T) +
-           std::string(" distribution: ") + distribution->ToString() +
-           StringPrintf(" etaA: %f etaB: %f", etaA, etaB) +
-           std::string(" fresnel: ") + fresnel.ToString() +
-           std::string(" mode : ") +
-           (mode == TransportMode::Radiance ? std::string("RADIANCE")
-                                            : std::string("IMPORTANCE")) +
+    return std::string("[ MicrofacetTransmission lobe: ") + lobe.ToString() +
            std::string(" ]");
 }
 
@@ -396,6 +374,19 @@ miScalar BxDF::Pdf(const Vector3f &wo, const Vector3f &wi) const {
     return SameHemisphere(wo, wi) ? AbsCosTheta(wi) * InvPi : 0;
 }
 
+void BxDF::Sample_f_batch(const Vector3f &wo, int nSamples, const Point2f *u,
+                          Vector3f *wi, miColor *f, miScalar *pdf) const {
+    for (int i = 0; i < nSamples; ++i) {
+        pdf[i] = 0;
+        f[i] = Sample_f(wo, &wi[i], u[i], &pdf[i]);
+    }
+}
+
+void BxDF::f_batch(const Vector3f &wo, int nSamples, const Vector3f *wi,
+                  miColor *f) const {
+    for (int i = 0; i < nSamples; ++i) f[i] = this->f(wo, wi[i]);
+}
+
 miColor LambertianTransmission::Sample_f(const Vector3f &wo, Vector3f *wi,
                                           const Point2f &u, miScalar *pdf,
                                           BxDFType *sampledType) const {
@@ -410,55 +401,6 @@ miScalar LambertianTransmission::Pdf(const Vector3f &wo,
     return !SameHemisphere(wo, wi) ? AbsCosTheta(wi) * InvPi : 0;
 }
 
-miColor MicrofacetReflection::Sample_f(const Vector3f &wo, Vector3f *wi,
-                                        const Point2f &u, miScalar *pdf,
-                                        BxDFType *sampledType) const {
-    // Sample microfacet orientation $\wh$ and reflected direction $\wi$
-    if (wo.z == 0) return BLA;
-    Vector3f wh = distribution->Sample_wh(wo, u);
-    *wi = Reflect(wo, wh);
-	if (!SameHemisphere(wo, *wi)) {
-		return BLA;
-	}
-
-    // Compute PDF of _wi_ for microfacet reflection
-    *pdf = distribution->Pdf(wo, wh) / (4 * Dot(wo, wh));
-    return f(wo, *wi);
-}
-
-miScalar MicrofacetReflection::Pdf(const Vector3f &wo, const Vector3f &wi) const {
-    if (!SameHemisphere(wo, wi)) return 0;
-    Vector3f wh = Normalize(wo + wi);
-    return distribution->Pdf(wo, wh) / (4 * Dot(wo, wh));
-}
-
-miColor MicrofacetTransmission::Sample_f(const Vector3f &wo, Vector3f *wi,
-                                          const Point2f &u, miScalar *pdf,
-                                          BxDFType *sampledType) const {
-    if (wo.z == 0) return BLA;
-    Vector3f wh = distribution->Sample_wh(wo, u);
-
-    miScalar eta = CosTheta(wo) > 0 ? (etaA / etaB) : (etaB / etaA);
-    if (!Refract(wo, (Normal3f)wh, eta, wi)) return BLA;
-    *pdf = Pdf(wo, *wi);
-
-    return f(wo, *wi);
-}
-
-miScalar MicrofacetTransmission::Pdf(const Vector3f &wo,
-                                  const Vector3f &wi) const {
-    if (SameHemisphere(wo, wi)) return 0;
-    // Compute $\wh$ from $\wo$ and $\wi$ for microfacet transmission
-    miScalar eta = CosTheta(wo) > 0 ? (etaB / etaA) : (etaA / etaB);
-    Vector3f wh = Normalize(wo + wi * eta);
-
-    // Compute change of variables _dwh\_dwi_ for microfacet transmission
-    miScalar sqrtDenom = Dot(wo, wh) + eta * Dot(wi, wh);
-    miScalar dwh_dwi =
-        std::abs((eta * eta * Dot(wi, wh)) / (sqrtDenom * sqrtDenom));
-    return distribution->Pdf(wo, wh) * dwh_dwi;
-}
-
 miColor FresnelBlend::Sample_f(const Vector3f &wo, Vector3f *wi,
                                 const Point2f &uOrig, miScalar *pdf,
                                 BxDFType *sampledType) const {
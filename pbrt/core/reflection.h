@@ -2,8 +2,10 @@
 // ADAPTED TO USE WITH MENTAL RAY
 //
 
+#if defined(_MSC_VER)
 #define NOMINMAX
 #pragma once
+#endif
 
 
 
@@ -22,16 +24,11 @@
 #include "slh_aux.h"
 #include "slh_pbrt.h"
 
-#include <iostream>;
+#include <iostream>
 using namespace std;
 
 namespace pbrt {
 
-// Reflection Declarations
-miScalar FrDielectric(miScalar cosThetaI, miScalar etaI, miScalar etaT);
-miColor FrConductor(miScalar cosThetaI, const miColor &etaI,
-                     const miColor &etaT, const miColor &k);
-
 // BSDF Inline Functions
 inline miScalar CosTheta(const Vector3f &w) { return w.z; }
 inline miScalar Cos2Theta(const Vector3f &w) { return w.z * w.z; }
@@ -95,6 +92,78 @@ inline bool SameHemisphere(const Vector3f &w, const Normal3f &wp) {
     return w.z * wp.z > 0;
 }
 
+// Reflection Inline Functions
+inline miScalar FrDielectric(miScalar cosThetaI, miScalar etaI, miScalar etaT) {
+    cosThetaI = Clamp(cosThetaI, -1, 1);
+    // Potentially swap indices of refraction
+    bool entering = cosThetaI > 0.f;
+    if (!entering) {
+        std::swap(etaI, etaT);
+        cosThetaI = std::abs(cosThetaI);
+    }
+
+    // Compute _cosThetaT_ using Snell's law
+    miScalar sinThetaI = std::sqrt(std::max((miScalar)0, 1 - cosThetaI * cosThetaI));
+    miScalar sinThetaT = etaI / etaT * sinThetaI;
+
+    // Handle total internal reflection
+    if (sinThetaT >= 1) return 1;
+    miScalar cosThetaT = std::sqrt(std::max((miScalar)0, 1 - sinThetaT * sinThetaT));
+    miScalar Rparl = ((etaT * cosThetaI) - (etaI * cosThetaT)) /
+                  ((etaT * cosThetaI) + (etaI * cosThetaT));
+    miScalar Rperp = ((etaI * cosThetaI) - (etaT * cosThetaT)) /
+                  ((etaI * cosThetaI) + (etaT * cosThetaT));
+    return (Rparl * Rparl + Rperp * Rperp) / 2;
+}
+
+// https://seblagarde.wordpress.com/2013/04/29/memo-on-fresnel-equations/
+inline miColor FrConductor(miScalar cosThetaI, const miColor &etai,
+                            const miColor &etat, const miColor &k) {
+    cosThetaI = Clamp(cosThetaI, -1, 1);
+    miColor eta = etat / etai;
+    miColor etak = k / etai;
+
+    miScalar cosThetaI2 = cosThetaI * cosThetaI;
+    miScalar sinThetaI2 = 1. - cosThetaI2;
+    miColor eta2 = eta * eta;
+    miColor etak2 = etak * etak;
+
+    miColor t0 = eta2 - etak2 - sinThetaI2;
+    miColor a2plusb2 = Sqrt(t0 * t0 + 4 * eta2 * etak2);
+    miColor t1 = a2plusb2 + cosThetaI2;
+    miColor a = Sqrt(0.5f * (a2plusb2 + t0));
+    miColor t2 = (miScalar)2 * cosThetaI * a;
+    miColor Rs = (t1 - t2) / (t1 + t2);
+
+    miColor t3 = cosThetaI2 * a2plusb2 + sinThetaI2 * sinThetaI2;
+    miColor t4 = t2 * sinThetaI2;
+    miColor Rp = Rs * (t3 - t4) / (t3 + t4);
+
+    return (miScalar)0.5 * (Rp + Rs);
+}
+
+// TrowbridgeReitzDistribution Inline Methods
+inline Float TrowbridgeReitzDistribution::D(const Vector3f &wh) const {
+    Float tan2Theta = Tan2Theta(wh);
+    if (std::isinf(tan2Theta)) return 0.;
+    const Float cos4Theta = Cos2Theta(wh) * Cos2Theta(wh);
+
+    Float e = (Cos2Phi(wh) / (alphax * alphax) + Sin2Phi(wh) / (alphay * alphay)) * tan2Theta;
+
+
+    return 1 / (Pi * alphax * alphay * cos4Theta * (1 + e) * (1 + e));
+}
+
+inline Float TrowbridgeReitzDistribution::Lambda(const Vector3f &w) const {
+    Float absTanTheta = std::abs(TanTheta(w));
+    if (std::isinf(absTanTheta)) return 0.;
+    // Compute _alpha_ for direction _w_
+    Float alpha =
+        std::sqrt(Cos2Phi(w) * alphax * alphax + Sin2Phi(w) * alphay * alphay);
+    Float alpha2Tan2Theta = (alpha * absTanTheta) * (alpha * absTanTheta);
+    return (-1 + std::sqrt(1.f + alpha2Tan2Theta)) / 2;
+}
+
 // BSDF Declarations
 enum BxDFType {
     BSDF_REFLECTION = 1 << 0,
@@ -208,6 +277,14 @@ class BxDF {
     virtual miColor rho(int nSamples, const Point2f *samples1,
                          const Point2f *samples2) const;
     virtual miScalar Pdf(const Vector3f &wo, const Vector3f &wi) const;
+    // Sample_f for nSamples sample points sharing the same _wo_, writing
+    // one entry per sample into the _wi_, _f_ and _pdf_ arrays
+    virtual void Sample_f_batch(const Vector3f &wo, int nSamples,
+                                const Point2f *u, Vector3f *wi, miColor *f,
+                                miScalar *pdf) const;
+    // f for nSamples directions _wi_ sharing the same _wo_
+    virtual void f_batch(const Vector3f &wo, int nSamples, const Vector3f *wi,
+                         miColor *f) const;
     virtual std::string ToString() const = 0;
 
     // BxDF Public Data
@@ -260,13 +337,62 @@ inline std::ostream &operator<<(std::ostream &os, const Fresnel &f) {
     return os;
 }
 
-class FresnelConductor : public Fresnel {
+// FresnelTable Declarations
+// Fresnel reflectance tabulated over a range of $\cos \theta_\roman{i}$ for
+// constant indices of refraction. Shaders build one per instance in their
+// _init function and hand it to FresnelDielectric / FresnelConductor, which
+// look it up instead of evaluating the Fresnel equations. Dielectric tables
+// only cover the side without total internal reflection, whose edge cannot
+// be interpolated accurately; the other side is still evaluated exactly.
+class FresnelTable {
+  public:
+    // FresnelTable Public Methods
+    void InitDielectric(miScalar etaI, miScalar etaT);
+    void InitConductor(const miColor &etaI, const miColor &etaT,
+                       const miColor &k);
+    bool MatchesDielectric(miScalar etaI, miScalar etaT) const {
+        return !conductor && this->etaI.r == etaI && this->etaT.r == etaT;
+    }
+    bool MatchesConductor(const miColor &etaI, const miColor &etaT,
+                          const miColor &k) const;
+    bool InRange(miScalar cosThetaI) const {
+        return cosThetaI >= cosMin && cosThetaI <= cosMin + 1;
+    }
+    miColor Lookup(miScalar cosThetaI) const {
+        miScalar x = Clamp(cosThetaI - cosMin, 0, 1) * (nEntries - 1);
+        int i = (int)x;
+        if (i > nEntries - 2) i = nEntries - 2;
+        miScalar t = x - i;
+        return values[i] * (1 - t) + values[i + 1] * t;
+    }
+
+    // Largest difference to the analytic Fresnel equations, measured
+    // between the table entries when the table is built
+    miScalar maxError;
+
+  private:
+    // FresnelTable Private Methods
+    template <typename Func>
+    void Build(Func fr);
+
+    // FresnelTable Private Data
+    static PBRT_CONSTEXPR int nEntries = 1025;
+    bool conductor;
+    miScalar cosMin;
+    miColor etaI, etaT, k;
+    miColor values[nEntries];
+};
+
+class FresnelConductor final : public Fresnel {
   public:
     // FresnelConductor Public Methods
-    miColor Evaluate(miScalar cosThetaI) const;
+    miColor Evaluate(miScalar cosThetaI) const {
+        if (table) return table->Lookup(std::abs(cosThetaI));
+        return FrConductor(std::abs(cosThetaI), etaI, etaT, k);
+    }
     FresnelConductor(const miColor &etaI, const miColor &etaT,
-                     const miColor &k)
-        : etaI(etaI), etaT(etaT), k(k) 
+                     const miColor &k, const FresnelTable *table = nullptr)
+        : etaI(etaI), etaT(etaT), k(k), table(table)
 	{
 		//cout << etaT << " " << k << "\n";
 	}
@@ -274,17 +400,26 @@ class FresnelConductor : public Fresnel {
 
   private:
     miColor etaI, etaT, k;
+    const FresnelTable *table;
 };
 
-class FresnelDielectric : public Fresnel {
+class FresnelDielectric final : public Fresnel {
   public:
     // FresnelDielectric Public Methods
-    miColor Evaluate(miScalar cosThetaI) const;
-    FresnelDielectric(miScalar etaI, miScalar etaT) : etaI(etaI), etaT(etaT) {}
+    miColor Evaluate(miScalar cosThetaI) const {
+        if (table && table->InRange(cosThetaI))
+            return table->Lookup(cosThetaI);
+        miScalar v = FrDielectric(cosThetaI, etaI, etaT);
+        return { v, v, v, 1.0 };
+    }
+    FresnelDielectric(miScalar etaI, miScalar etaT,
+                      const FresnelTable *table = nullptr)
+        : etaI(etaI), etaT(etaT), table(table) {}
     std::string ToString() const;
 
   private:
     miScalar etaI, etaT;
+    const FresnelTable *table;
 };
 
 class FresnelNoOp : public Fresnel {
@@ -404,17 +539,32 @@ class LambertianTransmission : public BxDF {
     miColor T;
 };
 
+// Oren-Nayar A and B terms, these only depend on sigma so shaders can
+// compute them once per instance
+struct OrenNayarTerms {
+    miScalar A, B;
+
+    static OrenNayarTerms FromSigma(miScalar sigma) {
+        sigma = Radians(sigma);
+        miScalar sigma2 = sigma * sigma;
+        return { 1.f - (sigma2 / (2.f * (sigma2 + 0.33f))),
+                 0.45f * sigma2 / (sigma2 + 0.09f) };
+    }
+};
+
 class OrenNayar : public BxDF {
   public:
     // OrenNayar Public Methods
     miColor f(const Vector3f &wo, const Vector3f &wi) const;
     OrenNayar(const miColor &R, miScalar sigma)
-        : BxDF(BxDFType(BSDF_REFLECTION | BSDF_DIFFUSE)), R(R) {
-        sigma = Radians(sigma);
-        miScalar sigma2 = sigma * sigma;
-        A = 1.f - (sigma2 / (2.f * (sigma2 + 0.33f)));
-        B = 0.45f * sigma2 / (sigma2 + 0.09f);
-    }
+        : OrenNayar(R, OrenNayarTerms::FromSigma(sigma)) {}
+    OrenNayar(const miColor &R, const OrenNayarTerms &terms)
+        : BxDF(BxDFType(BSDF_REFLECTION | BSDF_DIFFUSE)),
+          R(R),
+          A(terms.A),
+          B(terms.B) {}
+    void f_batch(const Vector3f &wo, int nSamples, const Vector3f *wi,
+                 miColor *f) const;
     std::string ToString() const;
 
   private:
@@ -423,32 +573,307 @@ class OrenNayar : public BxDF {
     miScalar A, B;
 };
 
-class MicrofacetReflection : public BxDF {
+// MicrofacetReflection with the distribution and Fresnel types fixed at
+// compile time. Both are held by value and every call on them is direct, so
+// the compiler can inline D(), Lambda() and Evaluate() into the sample loop.
+template <typename Distribution, typename FresnelT>
+class MicrofacetReflectionT final : public BxDF {
   public:
-    // MicrofacetReflection Public Methods
-    MicrofacetReflection(const miColor &R,
-                         MicrofacetDistribution *distribution, Fresnel *fresnel)
+    // MicrofacetReflectionT Public Methods
+    MicrofacetReflectionT(const miColor &R, const Distribution &distribution,
+                          const FresnelT &fresnel)
         : BxDF(BxDFType(BSDF_REFLECTION | BSDF_GLOSSY)),
           R(R),
           distribution(distribution),
           fresnel(fresnel) {}
-    miColor f(const Vector3f &wo, const Vector3f &wi) const;
+    miColor f(const Vector3f &wo, const Vector3f &wi) const {
+        miScalar cosThetaO = AbsCosTheta(wo), cosThetaI = AbsCosTheta(wi);
+        Vector3f wh = wi + wo;
+        // Handle degenerate cases for microfacet reflection
+        if (cosThetaI == 0 || cosThetaO == 0) return BLA;
+        if (wh.x == 0 && wh.y == 0 && wh.z == 0) return BLA;
+        wh = Normalize(wh);
+        miColor F = fresnel.Evaluate(Dot(wi, wh));
+        miScalar G = 1 / (1 + distribution.Lambda(wo) + distribution.Lambda(wi));
+        return R * distribution.D(wh) * G * F / (4 * cosThetaI * cosThetaO);
+    }
     miColor Sample_f(const Vector3f &wo, Vector3f *wi, const Point2f &u,
-                      miScalar *pdf, BxDFType *sampledType) const;
-    miScalar Pdf(const Vector3f &wo, const Vector3f &wi) const;
-    std::string ToString() const;
+                     miScalar *pdf, BxDFType *sampledType = nullptr) const {
+        // Sample microfacet orientation $\wh$ and reflected direction $\wi$
+        if (wo.z == 0) return BLA;
+        Vector3f wh = distribution.Sample_wh(wo, u);
+        *wi = Reflect(wo, wh);
+        if (!SameHemisphere(wo, *wi)) return BLA;
+
+        // Compute PDF of _wi_ for microfacet reflection
+        *pdf = Pdf_wh(wo, wh);
+        return f(wo, *wi);
+    }
+    miScalar Pdf(const Vector3f &wo, const Vector3f &wi) const {
+        if (!SameHemisphere(wo, wi)) return 0;
+        return Pdf_wh(wo, Normalize(wo + wi));
+    }
+    void Sample_f_batch(const Vector3f &wo, int nSamples, const Point2f *u,
+                        Vector3f *wi, miColor *f, miScalar *pdf) const {
+        // Terms that only depend on _wo_ are shared by every sample
+        miScalar cosThetaO = AbsCosTheta(wo);
+        miScalar lambdaO = distribution.Lambda(wo);
+        miScalar G1o = 1 / (1 + lambdaO);
+
+        for (int i = 0; i < nSamples; ++i) {
+            f[i] = BLA;
+            pdf[i] = 0;
+            if (wo.z == 0) continue;
+
+            // Sample microfacet orientation $\wh$ and reflected direction $\wi$
+            Vector3f wh = distribution.Sample_wh(wo, u[i]);
+            wi[i] = Reflect(wo, wh);
+            if (!SameHemisphere(wo, wi[i])) continue;
+
+            // $D(\wh)$ is shared by the PDF and the BRDF value
+            miScalar Dwh = distribution.D(wh);
+            pdf[i] = distribution.Pdf(wo, wh, Dwh, G1o) / (4 * Dot(wo, wh));
+
+            miScalar cosThetaI = AbsCosTheta(wi[i]);
+            Vector3f whf = wi[i] + wo;
+            if (cosThetaI == 0 || cosThetaO == 0) continue;
+            if (whf.x == 0 && whf.y == 0 && whf.z == 0) continue;
+            whf = Normalize(whf);
+            miScalar G = 1 / (1 + lambdaO + distribution.Lambda(wi[i]));
+            miColor F = fresnel.Evaluate(Dot(wi[i], whf));
+            f[i] = R * Dwh * G * F / (4 * cosThetaI * cosThetaO);
+        }
+    }
+    void f_batch(const Vector3f &wo, int nSamples, const Vector3f *wi,
+                 miColor *f) const {
+        // Terms that only depend on _wo_ are shared by every direction
+        miScalar cosThetaO = AbsCosTheta(wo);
+        miScalar lambdaO = distribution.Lambda(wo);
+
+        for (int i = 0; i < nSamples; ++i) {
+            f[i] = BLA;
+            miScalar cosThetaI = AbsCosTheta(wi[i]);
+            Vector3f wh = wi[i] + wo;
+            if (cosThetaI == 0 || cosThetaO == 0) continue;
+            if (wh.x == 0 && wh.y == 0 && wh.z == 0) continue;
+            wh = Normalize(wh);
+            miColor F = fresnel.Evaluate(Dot(wi[i], wh));
+            miScalar G = 1 / (1 + lambdaO + distribution.Lambda(wi[i]));
+            f[i] = R * distribution.D(wh) * G * F /
+                   (4 * cosThetaI * cosThetaO);
+        }
+    }
+    std::string ToString() const {
+        return std::string("[ MicrofacetReflectionT R: ") + MiToString(R) +
+               std::string(" distribution: ") + distribution.ToString() +
+               std::string(" fresnel: ") + fresnel.ToString() +
+               std::string(" ]");
+    }
 
-	//~MicrofacetReflection() {
-	//	if (distribution) delete distribution;
-	//	if (fresnel) delete fresnel;
-	//}
   private:
-    // MicrofacetReflection Private Data
+    // MicrofacetReflectionT Private Methods
+    miScalar Pdf_wh(const Vector3f &wo, const Vector3f &wh) const {
+        miScalar G1o = 1 / (1 + distribution.Lambda(wo));
+        return distribution.Pdf(wo, wh, distribution.D(wh), G1o) /
+               (4 * Dot(wo, wh));
+    }
+
+    // MicrofacetReflectionT Private Data
     const miColor R;
+    const Distribution distribution;
+    const FresnelT fresnel;
+};
+
+// MicrofacetTransmission with the distribution type fixed at compile time,
+// see MicrofacetReflectionT
+template <typename Distribution>
+class MicrofacetTransmissionT final : public BxDF {
+  public:
+    // MicrofacetTransmissionT Public Methods
+    MicrofacetTransmissionT(const miColor &T, const Distribution &distribution,
+                            miScalar etaA, miScalar etaB, TransportMode mode,
+                            const FresnelTable *fresnelTable = nullptr)
+        : BxDF(BxDFType(BSDF_TRANSMISSION | BSDF_GLOSSY)),
+          T(T),
+          distribution(distribution),
+          etaA(etaA),
+          etaB(etaB),
+          fresnel(etaA, etaB, fresnelTable),
+          mode(mode) {}
+    miColor f(const Vector3f &wo, const Vector3f &wi) const {
+        if (SameHemisphere(wo, wi)) return BLA;  // transmission only
+
+        miScalar cosThetaO = CosTheta(wo);
+        miScalar cosThetaI = CosTheta(wi);
+        if (cosThetaI == 0 || cosThetaO == 0) return BLA;
+
+        // Compute $\wh$ from $\wo$ and $\wi$ for microfacet transmission
+        miScalar eta = CosTheta(wo) > 0 ? (etaB / etaA) : (etaA / etaB);
+        Vector3f wh = Normalize(wo + wi * eta);
+        if (wh.z < 0) wh = -wh;
+
+        miColor F = fresnel.Evaluate(Dot(wo, wh));
+
+        miScalar sqrtDenom = Dot(wo, wh) + eta * Dot(wi, wh);
+        miScalar factor = (mode == TransportMode::Radiance) ? (1 / eta) : 1;
+        miScalar G = 1 / (1 + distribution.Lambda(wo) + distribution.Lambda(wi));
+
+        return (WHI - F) * T *
+               std::abs(distribution.D(wh) * G * eta * eta * AbsDot(wi, wh) *
+                        AbsDot(wo, wh) * factor * factor /
+                        (cosThetaI * cosThetaO * sqrtDenom * sqrtDenom));
+    }
+    miColor Sample_f(const Vector3f &wo, Vector3f *wi, const Point2f &u,
+                     miScalar *pdf, BxDFType *sampledType = nullptr) const {
+        if (wo.z == 0) return BLA;
+        Vector3f wh = distribution.Sample_wh(wo, u);
+
+        miScalar eta = CosTheta(wo) > 0 ? (etaA / etaB) : (etaB / etaA);
+        if (!Refract(wo, (Normal3f)wh, eta, wi)) return BLA;
+        *pdf = Pdf(wo, *wi);
+
+        return f(wo, *wi);
+    }
+    miScalar Pdf(const Vector3f &wo, const Vector3f &wi) const {
+        if (SameHemisphere(wo, wi)) return 0;
+        // Compute $\wh$ from $\wo$ and $\wi$ for microfacet transmission
+        miScalar eta = CosTheta(wo) > 0 ? (etaB / etaA) : (etaA / etaB);
+        Vector3f wh = Normalize(wo + wi * eta);
+
+        // Compute change of variables _dwh\_dwi_ for microfacet transmission
+        miScalar sqrtDenom = Dot(wo, wh) + eta * Dot(wi, wh);
+        miScalar dwh_dwi =
+            std::abs((eta * eta * Dot(wi, wh)) / (sqrtDenom * sqrtDenom));
+        miScalar G1o = 1 / (1 + distribution.Lambda(wo));
+        return distribution.Pdf(wo, wh, distribution.D(wh), G1o) * dwh_dwi;
+    }
+    void Sample_f_batch(const Vector3f &wo, int nSamples, const Point2f *u,
+                        Vector3f *wi, miColor *f, miScalar *pdf) const {
+        // Terms that only depend on _wo_ are shared by every sample
+        miScalar cosThetaO = CosTheta(wo);
+        miScalar etaSample = cosThetaO > 0 ? (etaA / etaB) : (etaB / etaA);
+        miScalar eta = cosThetaO > 0 ? (etaB / etaA) : (etaA / etaB);
+        miScalar factor = (mode == TransportMode::Radiance) ? (1 / eta) : 1;
+        miScalar lambdaO = distribution.Lambda(wo);
+        miScalar G1o = 1 / (1 + lambdaO);
+
+        for (int i = 0; i < nSamples; ++i) {
+            f[i] = BLA;
+            pdf[i] = 0;
+            if (wo.z == 0) continue;
+
+            Vector3f whs = distribution.Sample_wh(wo, u[i]);
+            if (!Refract(wo, (Normal3f)whs, etaSample, &wi[i])) continue;
+            if (SameHemisphere(wo, wi[i])) continue;  // transmission only
+
+            // Compute $\wh$ from $\wo$ and $\wi$ for microfacet transmission
+            Vector3f wh = Normalize(wo + wi[i] * eta);
+            miScalar sqrtDenom = Dot(wo, wh) + eta * Dot(wi[i], wh);
+
+            // $D(\wh)$ is shared by the PDF and the BTDF value
+            miScalar Dwh = distribution.D(wh);
+            miScalar dwh_dwi = std::abs((eta * eta * Dot(wi[i], wh)) /
+                                        (sqrtDenom * sqrtDenom));
+            pdf[i] = distribution.Pdf(wo, wh, Dwh, G1o) * dwh_dwi;
+
+            miScalar cosThetaI = CosTheta(wi[i]);
+            if (cosThetaI == 0 || cosThetaO == 0) continue;
+            if (wh.z < 0) wh = -wh;
+
+            miColor F = fresnel.Evaluate(Dot(wo, wh));
+            miScalar G = 1 / (1 + lambdaO + distribution.Lambda(wi[i]));
+            f[i] = (WHI - F) * T *
+                   std::abs(Dwh * G * eta * eta * AbsDot(wi[i], wh) *
+                            AbsDot(wo, wh) * factor * factor /
+                            (cosThetaI * cosThetaO * sqrtDenom * sqrtDenom));
+        }
+    }
+    std::string ToString() const {
+        return std::string("[ MicrofacetTransmissionT T: ") + MiToString(T) +
+               std::string(" distribution: ") + distribution.ToString() +
+               StringPrintf(" etaA: %f etaB: %f", etaA, etaB) +
+               std::string(" fresnel: ") + fresnel.ToString() +
+               std::string(" mode : ") +
+               (mode == TransportMode::Radiance ? std::string("RADIANCE")
+                                                : std::string("IMPORTANCE")) +
+               std::string(" ]");
+    }
+
+  private:
+    // MicrofacetTransmissionT Private Data
+    const miColor T;
+    const Distribution distribution;
+    const miScalar etaA, etaB;
+    const FresnelDielectric fresnel;
+    const TransportMode mode;
+};
+
+// Forwards to a MicrofacetDistribution through its virtual interface, so the
+// polymorphic lobes below can be built on the templated ones
+class MicrofacetDistributionRef {
+  public:
+    explicit MicrofacetDistributionRef(const MicrofacetDistribution *distribution)
+        : distribution(distribution) {}
+    miScalar D(const Vector3f &wh) const { return distribution->D(wh); }
+    miScalar Lambda(const Vector3f &w) const { return distribution->Lambda(w); }
+    Vector3f Sample_wh(const Vector3f &wo, const Point2f &u) const {
+        return distribution->Sample_wh(wo, u);
+    }
+    miScalar Pdf(const Vector3f &wo, const Vector3f &wh, miScalar Dwh,
+                 miScalar G1wo) const {
+        return distribution->Pdf(wo, wh, Dwh, G1wo);
+    }
+    std::string ToString() const { return distribution->ToString(); }
+
+  private:
     const MicrofacetDistribution *distribution;
+};
+
+// Fresnel counterpart of MicrofacetDistributionRef
+class FresnelRef {
+  public:
+    explicit FresnelRef(const Fresnel *fresnel) : fresnel(fresnel) {}
+    miColor Evaluate(miScalar cosI) const { return fresnel->Evaluate(cosI); }
+    std::string ToString() const { return fresnel->ToString(); }
+
+  private:
     const Fresnel *fresnel;
 };
 
+// MicrofacetReflection and MicrofacetTransmission take the distribution and
+// Fresnel term at run time and share the code of the templated lobes above
+class MicrofacetReflection : public BxDF {
+  public:
+    // MicrofacetReflection Public Methods
+    MicrofacetReflection(const miColor &R,
+                         MicrofacetDistribution *distribution, Fresnel *fresnel)
+        : BxDF(BxDFType(BSDF_REFLECTION | BSDF_GLOSSY)),
+          lobe(R, MicrofacetDistributionRef(distribution), FresnelRef(fresnel)) {}
+    miColor f(const Vector3f &wo, const Vector3f &wi) const {
+        return lobe.f(wo, wi);
+    }
+    miColor Sample_f(const Vector3f &wo, Vector3f *wi, const Point2f &u,
+                      miScalar *pdf, BxDFType *sampledType) const {
+        return lobe.Sample_f(wo, wi, u, pdf, sampledType);
+    }
+    miScalar Pdf(const Vector3f &wo, const Vector3f &wi) const {
+        return lobe.Pdf(wo, wi);
+    }
+    void Sample_f_batch(const Vector3f &wo, int nSamples, const Point2f *u,
+                        Vector3f *wi, miColor *f, miScalar *pdf) const {
+        lobe.Sample_f_batch(wo, nSamples, u, wi, f, pdf);
+    }
+    void f_batch(const Vector3f &wo, int nSamples, const Vector3f *wi,
+                 miColor *f) const {
+        lobe.f_batch(wo, nSamples, wi, f);
+    }
+    std::string ToString() const;
+
+  private:
+    // MicrofacetReflection Private Data
+    const MicrofacetReflectionT<MicrofacetDistributionRef, FresnelRef> lobe;
+};
+
 class MicrofacetTransmission : public BxDF {
   public:
     // MicrofacetTransmission Public Methods
@@ -456,25 +881,118 @@ class MicrofacetTransmission : public BxDF {
                            MicrofacetDistribution *distribution, miScalar etaA,
                            miScalar etaB, TransportMode mode)
         : BxDF(BxDFType(BSDF_TRANSMISSION | BSDF_GLOSSY)),
-          T(T),
+          lobe(T, MicrofacetDistributionRef(distribution), etaA, etaB, mode) {}
+    miColor f(const Vector3f &wo, const Vector3f &wi) const {
+        return lobe.f(wo, wi);
+    }
+    miColor Sample_f(const Vector3f &wo, Vector3f *wi, const Point2f &u,
+                      miScalar *pdf, BxDFType *sampledType) const {
+        return lobe.Sample_f(wo, wi, u, pdf, sampledType);
+    }
+    miScalar Pdf(const Vector3f &wo, const Vector3f &wi) const {
+        return lobe.Pdf(wo, wi);
+    }
+    void Sample_f_batch(const Vector3f &wo, int nSamples, const Point2f *u,
+                        Vector3f *wi, miColor *f, miScalar *pdf) const {
+        lobe.Sample_f_batch(wo, nSamples, u, wi, f, pdf);
+    }
+    std::string ToString() const;
+
+  private:
+    // MicrofacetTransmission Private Data
+    const MicrofacetTransmissionT<MicrofacetDistributionRef> lobe;
+};
+
+// Rough counterpart of FresnelSpecular: a microfacet normal is sampled first and
+// reflection or transmission is chosen through it with probability equal to the
+// Fresnel term, so a single sample covers both lobes
+template <typename Distribution>
+class FresnelMicrofacetT final : public BxDF {
+  public:
+    // FresnelMicrofacetT Public Methods
+    FresnelMicrofacetT(const miColor &R, const miColor &T,
+                       const Distribution &distribution, miScalar etaA,
+                       miScalar etaB, TransportMode mode,
+                       const FresnelTable *fresnelTable = nullptr)
+        : BxDF(BxDFType(BSDF_REFLECTION | BSDF_TRANSMISSION | BSDF_GLOSSY)),
           distribution(distribution),
           etaA(etaA),
           etaB(etaB),
-          fresnel(etaA, etaB),
-          mode(mode) {}
-    miColor f(const Vector3f &wo, const Vector3f &wi) const;
+          fresnel(etaA, etaB, fresnelTable),
+          reflection(R, distribution, fresnel),
+          transmission(T, distribution, etaA, etaB, mode, fresnelTable) {}
+    miColor f(const Vector3f &wo, const Vector3f &wi) const {
+        return SameHemisphere(wo, wi) ? reflection.f(wo, wi)
+                                      : transmission.f(wo, wi);
+    }
+    // _uc_ chooses between reflection and transmission
     miColor Sample_f(const Vector3f &wo, Vector3f *wi, const Point2f &u,
-                      miScalar *pdf, BxDFType *sampledType) const;
-    miScalar Pdf(const Vector3f &wo, const Vector3f &wi) const;
-    std::string ToString() const;
+                     miScalar uc, miScalar *pdf,
+                     BxDFType *sampledType = nullptr) const {
+        *pdf = 0;
+        if (wo.z == 0) return BLA;
+        Vector3f wh = distribution.Sample_wh(wo, u);
+
+        miScalar F = ChooseReflection(wo, wh);
+        if (uc < F) {
+            // Compute microfacet reflection for _FresnelMicrofacetT_
+            *wi = Reflect(wo, wh);
+            if (!SameHemisphere(wo, *wi)) return BLA;
+            if (sampledType)
+                *sampledType = BxDFType(BSDF_GLOSSY | BSDF_REFLECTION);
+            *pdf = reflection.Pdf(wo, *wi) * F;
+            return reflection.f(wo, *wi);
+        } else {
+            // Compute microfacet transmission for _FresnelMicrofacetT_
+            miScalar eta = CosTheta(wo) > 0 ? (etaA / etaB) : (etaB / etaA);
+            if (!Refract(wo, (Normal3f)wh, eta, wi)) return BLA;
+            if (SameHemisphere(wo, *wi)) return BLA;
+            if (sampledType)
+                *sampledType = BxDFType(BSDF_GLOSSY | BSDF_TRANSMISSION);
+            *pdf = transmission.Pdf(wo, *wi) * (1 - F);
+            return transmission.f(wo, *wi);
+        }
+    }
+    // Without a third sample dimension _uc_ is a hash of both dimensions of
+    // _u_. Reusing digits of _u[0]_ would tie the choice to the orientation
+    // of $\wh$ under stratified or QMC samples; the hash is decorrelated from
+    // it but not stratified, so callers with a spare dimension should pass it
+    miColor Sample_f(const Vector3f &wo, Vector3f *wi, const Point2f &u,
+                     miScalar *pdf, BxDFType *sampledType = nullptr) const {
+        uint64_t bits = (uint64_t)FloatToBits((float)u[0]) << 32 |
+                        FloatToBits((float)u[1]);
+        miScalar uc = (MixBits(bits) >> 40) * (1.f / (1 << 24));
+        return Sample_f(wo, wi, u, uc, pdf, sampledType);
+    }
+    miScalar Pdf(const Vector3f &wo, const Vector3f &wi) const {
+        if (SameHemisphere(wo, wi))
+            return reflection.Pdf(wo, wi) *
+                   ChooseReflection(wo, Normalize(wo + wi));
+
+        miScalar eta = CosTheta(wo) > 0 ? (etaB / etaA) : (etaA / etaB);
+        return transmission.Pdf(wo, wi) *
+               (1 - ChooseReflection(wo, Normalize(wo + wi * eta)));
+    }
+    std::string ToString() const {
+        return std::string("[ FresnelMicrofacetT reflection: ") +
+               reflection.ToString() + std::string(" transmission: ") +
+               transmission.ToString() + std::string(" ]");
+    }
 
   private:
-    // MicrofacetTransmission Private Data
-    const miColor T;
-    const MicrofacetDistribution *distribution;
+    // FresnelMicrofacetT Private Methods
+    miScalar ChooseReflection(const Vector3f &wo, Vector3f wh) const {
+        // Same Fresnel term as the lobes, which evaluate it with $\wh$ facing up
+        if (wh.z < 0) wh = -wh;
+        return fresnel.Evaluate(Dot(wo, wh)).r;
+    }
+
+    // FresnelMicrofacetT Private Data
+    const Distribution distribution;
     const miScalar etaA, etaB;
     const FresnelDielectric fresnel;
-    const TransportMode mode;
+    const MicrofacetReflectionT<Distribution, FresnelDielectric> reflection;
+    const MicrofacetTransmissionT<Distribution> transmission;
 };
 
 class FresnelBlend : public BxDF {
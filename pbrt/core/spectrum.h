@@ -42,12 +42,23 @@
 #include "pbrt.h"
 #include "stringprint.h"
 
+// Spectrum SIMD Declarations, SLH_NO_SIMD keeps the scalar loops
+#if defined(SLH_NO_SIMD) || defined(PBRT_FLOAT_AS_DOUBLE)
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PBRT_SPECTRUM_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define PBRT_SPECTRUM_NEON
+#include <arm_neon.h>
+#endif
+
 namespace pbrt {
 
 // Spectrum Utility Declarations
 static const int sampledLambdaStart = 400;
 static const int sampledLambdaEnd = 700;
-static const int nSpectralSamples = 60;
+static const int nSpectralSamples = 60;  // kept a multiple of 4 for SpectrumLanes
 extern bool SpectrumSamplesSorted(const Float *lambda, const Float *vals,
                                   int n);
 extern void SortSpectrumSamples(Float *lambda, Float *vals, int n);
@@ -96,12 +107,89 @@ extern const Float RGBIllum2SpectRed[nRGB2SpectSamples];
 extern const Float RGBIllum2SpectGreen[nRGB2SpectSamples];
 extern const Float RGBIllum2SpectBlue[nRGB2SpectSamples];
 
+#if defined(PBRT_SPECTRUM_SSE) || defined(PBRT_SPECTRUM_NEON)
+#define PBRT_SPECTRUM_LANES
+
+// Four samples at a time; CoefficientSpectrum uses these when its sample
+// count is a multiple of four, e.g. SampledSpectrum's 60
+struct SpectrumLanes {
+#ifdef PBRT_SPECTRUM_SSE
+    __m128 v;
+    SpectrumLanes(__m128 v) : v(v) {}
+    explicit SpectrumLanes(Float s) : v(_mm_set1_ps(s)) {}
+    static SpectrumLanes Load(const Float *p) { return _mm_loadu_ps(p); }
+    void Store(Float *p) const { _mm_storeu_ps(p, v); }
+#else
+    float32x4_t v;
+    SpectrumLanes(float32x4_t v) : v(v) {}
+    explicit SpectrumLanes(Float s) : v(vdupq_n_f32(s)) {}
+    static SpectrumLanes Load(const Float *p) { return vld1q_f32(p); }
+    void Store(Float *p) const { vst1q_f32(p, v); }
+#endif
+};
+
+#ifdef PBRT_SPECTRUM_SSE
+inline SpectrumLanes operator+(SpectrumLanes a, SpectrumLanes b) { return _mm_add_ps(a.v, b.v); }
+inline SpectrumLanes operator-(SpectrumLanes a, SpectrumLanes b) { return _mm_sub_ps(a.v, b.v); }
+inline SpectrumLanes operator*(SpectrumLanes a, SpectrumLanes b) { return _mm_mul_ps(a.v, b.v); }
+inline SpectrumLanes operator/(SpectrumLanes a, SpectrumLanes b) { return _mm_div_ps(a.v, b.v); }
+inline SpectrumLanes operator-(SpectrumLanes a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.f)); }
+inline SpectrumLanes Sqrt(SpectrumLanes a) { return _mm_sqrt_ps(a.v); }
+// NaN lanes of a pass through, as with pbrt::Clamp
+inline SpectrumLanes Clamp(SpectrumLanes a, SpectrumLanes low, SpectrumLanes high) {
+    return _mm_min_ps(high.v, _mm_max_ps(low.v, a.v));
+}
+inline bool AnyNotEqual(SpectrumLanes a, SpectrumLanes b) {
+    return _mm_movemask_ps(_mm_cmpneq_ps(a.v, b.v)) != 0;
+}
+inline Float HorizontalSum(SpectrumLanes a) {
+    __m128 s = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+    return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+}
+inline Float HorizontalMax(SpectrumLanes a) {
+    __m128 m = _mm_max_ps(a.v, _mm_movehl_ps(a.v, a.v));
+    return _mm_cvtss_f32(_mm_max_ss(m, _mm_shuffle_ps(m, m, 1)));
+}
+inline SpectrumLanes Max(SpectrumLanes a, SpectrumLanes b) { return _mm_max_ps(a.v, b.v); }
+#else
+inline SpectrumLanes operator+(SpectrumLanes a, SpectrumLanes b) { return vaddq_f32(a.v, b.v); }
+inline SpectrumLanes operator-(SpectrumLanes a, SpectrumLanes b) { return vsubq_f32(a.v, b.v); }
+inline SpectrumLanes operator*(SpectrumLanes a, SpectrumLanes b) { return vmulq_f32(a.v, b.v); }
+inline SpectrumLanes operator/(SpectrumLanes a, SpectrumLanes b) { return vdivq_f32(a.v, b.v); }
+inline SpectrumLanes operator-(SpectrumLanes a) { return vnegq_f32(a.v); }
+inline SpectrumLanes Sqrt(SpectrumLanes a) { return vsqrtq_f32(a.v); }
+inline SpectrumLanes Clamp(SpectrumLanes a, SpectrumLanes low, SpectrumLanes high) {
+    return vminnmq_f32(high.v, vmaxnmq_f32(low.v, a.v));
+}
+inline bool AnyNotEqual(SpectrumLanes a, SpectrumLanes b) {
+    return vminvq_u32(vceqq_f32(a.v, b.v)) == 0;
+}
+inline Float HorizontalSum(SpectrumLanes a) { return vaddvq_f32(a.v); }
+inline Float HorizontalMax(SpectrumLanes a) { return vmaxvq_f32(a.v); }
+inline SpectrumLanes Max(SpectrumLanes a, SpectrumLanes b) { return vmaxq_f32(a.v, b.v); }
+#endif
+#endif  // PBRT_SPECTRUM_SSE || PBRT_SPECTRUM_NEON
+
+// 16-byte aligned storage for the sample counts the lanes handle
+#ifdef PBRT_HAVE_ALIGNAS
+#define PBRT_SPECTRUM_ALIGN(n) alignas((n) % 4 == 0 ? 16 : sizeof(Float))
+#else
+#define PBRT_SPECTRUM_ALIGN(n)
+#endif
+
 // Spectrum Declarations
 template <int nSpectrumSamples>
 class CoefficientSpectrum {
   public:
     // CoefficientSpectrum Public Methods
     CoefficientSpectrum(Float v = 0.f) {
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                SpectrumLanes(v).Store(c + i);
+            return;
+        }
+#endif
         for (int i = 0; i < nSpectrumSamples; ++i) c[i] = v;
         //DCHECK(!HasNaNs());
     }
@@ -127,23 +215,54 @@ class CoefficientSpectrum {
     }
     CoefficientSpectrum &operator+=(const CoefficientSpectrum &s2) {
         //DCHECK(!s2.HasNaNs());
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                (SpectrumLanes::Load(c + i) + SpectrumLanes::Load(s2.c + i)).Store(c + i);
+            return *this;
+        }
+#endif
         for (int i = 0; i < nSpectrumSamples; ++i) c[i] += s2.c[i];
         return *this;
     }
     CoefficientSpectrum operator+(const CoefficientSpectrum &s2) const {
         //DCHECK(!s2.HasNaNs());
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            CoefficientSpectrum ret;
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                (SpectrumLanes::Load(c + i) + SpectrumLanes::Load(s2.c + i)).Store(ret.c + i);
+            return ret;
+        }
+#endif
         CoefficientSpectrum ret = *this;
         for (int i = 0; i < nSpectrumSamples; ++i) ret.c[i] += s2.c[i];
         return ret;
     }
     CoefficientSpectrum operator-(const CoefficientSpectrum &s2) const {
         //DCHECK(!s2.HasNaNs());
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            CoefficientSpectrum ret;
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                (SpectrumLanes::Load(c + i) - SpectrumLanes::Load(s2.c + i)).Store(ret.c + i);
+            return ret;
+        }
+#endif
         CoefficientSpectrum ret = *this;
         for (int i = 0; i < nSpectrumSamples; ++i) ret.c[i] -= s2.c[i];
         return ret;
     }
     CoefficientSpectrum operator/(const CoefficientSpectrum &s2) const {
         //DCHECK(!s2.HasNaNs());
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            CoefficientSpectrum ret;
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                (SpectrumLanes::Load(c + i) / SpectrumLanes::Load(s2.c + i)).Store(ret.c + i);
+            return ret;
+        }
+#endif
         CoefficientSpectrum ret = *this;
         for (int i = 0; i < nSpectrumSamples; ++i) {
          //CHECK_NE(s2.c[i], 0);
@@ -153,22 +272,52 @@ class CoefficientSpectrum {
     }
     CoefficientSpectrum operator*(const CoefficientSpectrum &sp) const {
         //DCHECK(!sp.HasNaNs());
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            CoefficientSpectrum ret;
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                (SpectrumLanes::Load(c + i) * SpectrumLanes::Load(sp.c + i)).Store(ret.c + i);
+            return ret;
+        }
+#endif
         CoefficientSpectrum ret = *this;
         for (int i = 0; i < nSpectrumSamples; ++i) ret.c[i] *= sp.c[i];
         return ret;
     }
     CoefficientSpectrum &operator*=(const CoefficientSpectrum &sp) {
         //DCHECK(!sp.HasNaNs());
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                (SpectrumLanes::Load(c + i) * SpectrumLanes::Load(sp.c + i)).Store(c + i);
+            return *this;
+        }
+#endif
         for (int i = 0; i < nSpectrumSamples; ++i) c[i] *= sp.c[i];
         return *this;
     }
     CoefficientSpectrum operator*(Float a) const {
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            CoefficientSpectrum ret;
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                (SpectrumLanes::Load(c + i) * SpectrumLanes(a)).Store(ret.c + i);
+            return ret;
+        }
+#endif
         CoefficientSpectrum ret = *this;
         for (int i = 0; i < nSpectrumSamples; ++i) ret.c[i] *= a;
         //DCHECK(!ret.HasNaNs());
         return ret;
     }
     CoefficientSpectrum &operator*=(Float a) {
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                (SpectrumLanes::Load(c + i) * SpectrumLanes(a)).Store(c + i);
+            return *this;
+        }
+#endif
         for (int i = 0; i < nSpectrumSamples; ++i) c[i] *= a;
         //DCHECK(!HasNaNs());
         return *this;
@@ -181,6 +330,14 @@ class CoefficientSpectrum {
     CoefficientSpectrum operator/(Float a) const {
        //CHECK_NE(a, 0);
         //DCHECK(!std::isnan(a));
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            CoefficientSpectrum ret;
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                (SpectrumLanes::Load(c + i) / SpectrumLanes(a)).Store(ret.c + i);
+            return ret;
+        }
+#endif
         CoefficientSpectrum ret = *this;
         for (int i = 0; i < nSpectrumSamples; ++i) ret.c[i] /= a;
         //DCHECK(!ret.HasNaNs());
@@ -189,10 +346,25 @@ class CoefficientSpectrum {
     CoefficientSpectrum &operator/=(Float a) {
        //CHECK_NE(a, 0);
         //DCHECK(!std::isnan(a));
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                (SpectrumLanes::Load(c + i) / SpectrumLanes(a)).Store(c + i);
+            return *this;
+        }
+#endif
         for (int i = 0; i < nSpectrumSamples; ++i) c[i] /= a;
         return *this;
     }
     bool operator==(const CoefficientSpectrum &sp) const {
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                if (AnyNotEqual(SpectrumLanes::Load(c + i), SpectrumLanes::Load(sp.c + i)))
+                    return false;
+            return true;
+        }
+#endif
         for (int i = 0; i < nSpectrumSamples; ++i)
             if (c[i] != sp.c[i]) return false;
         return true;
@@ -201,12 +373,27 @@ class CoefficientSpectrum {
         return !(*this == sp);
     }
     bool IsBlack() const {
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                if (AnyNotEqual(SpectrumLanes::Load(c + i), SpectrumLanes(0.f)))
+                    return false;
+            return true;
+        }
+#endif
         for (int i = 0; i < nSpectrumSamples; ++i)
             if (c[i] != 0.) return false;
         return true;
     }
     friend CoefficientSpectrum Sqrt(const CoefficientSpectrum &s) {
         CoefficientSpectrum ret;
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                Sqrt(SpectrumLanes::Load(s.c + i)).Store(ret.c + i);
+            return ret;
+        }
+#endif
         for (int i = 0; i < nSpectrumSamples; ++i) ret.c[i] = std::sqrt(s.c[i]);
         //DCHECK(!ret.HasNaNs());
         return ret;
@@ -216,6 +403,13 @@ class CoefficientSpectrum {
                                              Float e);
     CoefficientSpectrum operator-() const {
         CoefficientSpectrum ret;
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                (-SpectrumLanes::Load(c + i)).Store(ret.c + i);
+            return ret;
+        }
+#endif
         for (int i = 0; i < nSpectrumSamples; ++i) ret.c[i] = -c[i];
         return ret;
     }
@@ -240,12 +434,28 @@ class CoefficientSpectrum {
     }
     CoefficientSpectrum Clamp(Float low = 0, Float high = Infinity) const {
         CoefficientSpectrum ret;
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            for (int i = 0; i < nSpectrumSamples; i += 4)
+                pbrt::Clamp(SpectrumLanes::Load(c + i), SpectrumLanes(low), SpectrumLanes(high))
+                    .Store(ret.c + i);
+            return ret;
+        }
+#endif
         for (int i = 0; i < nSpectrumSamples; ++i)
             ret.c[i] = pbrt::Clamp(c[i], low, high);
         //DCHECK(!ret.HasNaNs());
         return ret;
     }
     Float MaxComponentValue() const {
+#ifdef PBRT_SPECTRUM_LANES
+        if (useLanes) {
+            SpectrumLanes m = SpectrumLanes::Load(c);
+            for (int i = 4; i < nSpectrumSamples; i += 4)
+                m = Max(m, SpectrumLanes::Load(c + i));
+            return HorizontalMax(m);
+        }
+#endif
         Float m = c[0];
         for (int i = 1; i < nSpectrumSamples; ++i)
             m = std::max(m, c[i]);
@@ -282,8 +492,15 @@ class CoefficientSpectrum {
     static const int nSamples = nSpectrumSamples;
 
   protected:
+    // CoefficientSpectrum Protected Methods
+    struct ConstexprInit {};
+    constexpr CoefficientSpectrum(ConstexprInit) : c() {}
+
     // CoefficientSpectrum Protected Data
-    Float c[nSpectrumSamples];
+    PBRT_SPECTRUM_ALIGN(nSpectrumSamples) Float c[nSpectrumSamples];
+#ifdef PBRT_SPECTRUM_LANES
+    static const bool useLanes = nSpectrumSamples % 4 == 0;
+#endif
 };
 
 class SampledSpectrum : public CoefficientSpectrum<nSpectralSamples> {
@@ -312,78 +529,26 @@ class SampledSpectrum : public CoefficientSpectrum<nSpectralSamples> {
         }
         return r;
     }
-    static void Init() {
-        // Compute XYZ matching functions for _SampledSpectrum_
-        for (int i = 0; i < nSpectralSamples; ++i) {
-            Float wl0 = Lerp(Float(i) / Float(nSpectralSamples),
-                             sampledLambdaStart, sampledLambdaEnd);
-            Float wl1 = Lerp(Float(i + 1) / Float(nSpectralSamples),
-                             sampledLambdaStart, sampledLambdaEnd);
-            X.c[i] = AverageSpectrumSamples(CIE_lambda, CIE_X, nCIESamples, wl0,
-                                            wl1);
-            Y.c[i] = AverageSpectrumSamples(CIE_lambda, CIE_Y, nCIESamples, wl0,
-                                            wl1);
-            Z.c[i] = AverageSpectrumSamples(CIE_lambda, CIE_Z, nCIESamples, wl0,
-                                            wl1);
-        }
-
-        // Compute RGB to spectrum functions for _SampledSpectrum_
-        for (int i = 0; i < nSpectralSamples; ++i) {
-            Float wl0 = Lerp(Float(i) / Float(nSpectralSamples),
-                             sampledLambdaStart, sampledLambdaEnd);
-            Float wl1 = Lerp(Float(i + 1) / Float(nSpectralSamples),
-                             sampledLambdaStart, sampledLambdaEnd);
-            rgbRefl2SpectWhite.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBRefl2SpectWhite,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbRefl2SpectCyan.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBRefl2SpectCyan,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbRefl2SpectMagenta.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBRefl2SpectMagenta,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbRefl2SpectYellow.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBRefl2SpectYellow,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbRefl2SpectRed.c[i] = AverageSpectrumSamples(
-                RGB2SpectLambda, RGBRefl2SpectRed, nRGB2SpectSamples, wl0, wl1);
-            rgbRefl2SpectGreen.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBRefl2SpectGreen,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbRefl2SpectBlue.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBRefl2SpectBlue,
-                                       nRGB2SpectSamples, wl0, wl1);
-
-            rgbIllum2SpectWhite.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBIllum2SpectWhite,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbIllum2SpectCyan.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBIllum2SpectCyan,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbIllum2SpectMagenta.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBIllum2SpectMagenta,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbIllum2SpectYellow.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBIllum2SpectYellow,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbIllum2SpectRed.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBIllum2SpectRed,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbIllum2SpectGreen.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBIllum2SpectGreen,
-                                       nRGB2SpectSamples, wl0, wl1);
-            rgbIllum2SpectBlue.c[i] =
-                AverageSpectrumSamples(RGB2SpectLambda, RGBIllum2SpectBlue,
-                                       nRGB2SpectSamples, wl0, wl1);
-        }
-    }
     void ToXYZ(Float xyz[3]) const {
+#ifdef PBRT_SPECTRUM_LANES
+        SpectrumLanes x(0.f), y(0.f), z(0.f);
+        for (int i = 0; i < nSpectralSamples; i += 4) {
+            SpectrumLanes v = SpectrumLanes::Load(c + i);
+            x = x + SpectrumLanes::Load(X.c + i) * v;
+            y = y + SpectrumLanes::Load(Y.c + i) * v;
+            z = z + SpectrumLanes::Load(Z.c + i) * v;
+        }
+        xyz[0] = HorizontalSum(x);
+        xyz[1] = HorizontalSum(y);
+        xyz[2] = HorizontalSum(z);
+#else
         xyz[0] = xyz[1] = xyz[2] = 0.f;
         for (int i = 0; i < nSpectralSamples; ++i) {
             xyz[0] += X.c[i] * c[i];
             xyz[1] += Y.c[i] * c[i];
             xyz[2] += Z.c[i] * c[i];
         }
+#endif
         Float scale = Float(sampledLambdaEnd - sampledLambdaStart) /
                       Float(CIE_Y_integral * nSpectralSamples);
         xyz[0] *= scale;
@@ -391,8 +556,15 @@ class SampledSpectrum : public CoefficientSpectrum<nSpectralSamples> {
         xyz[2] *= scale;
     }
     Float y() const {
+#ifdef PBRT_SPECTRUM_LANES
+        SpectrumLanes sum(0.f);
+        for (int i = 0; i < nSpectralSamples; i += 4)
+            sum = sum + SpectrumLanes::Load(Y.c + i) * SpectrumLanes::Load(c + i);
+        Float yy = HorizontalSum(sum);
+#else
         Float yy = 0.f;
         for (int i = 0; i < nSpectralSamples; ++i) yy += Y.c[i] * c[i];
+#endif
         return yy * Float(sampledLambdaEnd - sampledLambdaStart) /
                Float(CIE_Y_integral * nSpectralSamples);
     }
@@ -414,16 +586,19 @@ class SampledSpectrum : public CoefficientSpectrum<nSpectralSamples> {
                     SpectrumType type = SpectrumType::Reflectance);
 
   private:
+    // SampledSpectrum Private Methods
+    constexpr SampledSpectrum(const Float *lambda, const Float *v, int n);
+
     // SampledSpectrum Private Data
-    static SampledSpectrum X, Y, Z;
-    static SampledSpectrum rgbRefl2SpectWhite, rgbRefl2SpectCyan;
-    static SampledSpectrum rgbRefl2SpectMagenta, rgbRefl2SpectYellow;
-    static SampledSpectrum rgbRefl2SpectRed, rgbRefl2SpectGreen;
-    static SampledSpectrum rgbRefl2SpectBlue;
-    static SampledSpectrum rgbIllum2SpectWhite, rgbIllum2SpectCyan;
-    static SampledSpectrum rgbIllum2SpectMagenta, rgbIllum2SpectYellow;
-    static SampledSpectrum rgbIllum2SpectRed, rgbIllum2SpectGreen;
-    static SampledSpectrum rgbIllum2SpectBlue;
+    static const SampledSpectrum X, Y, Z;
+    static const SampledSpectrum rgbRefl2SpectWhite, rgbRefl2SpectCyan;
+    static const SampledSpectrum rgbRefl2SpectMagenta, rgbRefl2SpectYellow;
+    static const SampledSpectrum rgbRefl2SpectRed, rgbRefl2SpectGreen;
+    static const SampledSpectrum rgbRefl2SpectBlue;
+    static const SampledSpectrum rgbIllum2SpectWhite, rgbIllum2SpectCyan;
+    static const SampledSpectrum rgbIllum2SpectMagenta, rgbIllum2SpectYellow;
+    static const SampledSpectrum rgbIllum2SpectRed, rgbIllum2SpectGreen;
+    static const SampledSpectrum rgbIllum2SpectBlue;
 };
 
 class RGBSpectrum : public CoefficientSpectrum<3> {
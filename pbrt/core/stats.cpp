@@ -0,0 +1,53 @@
+// core/stats.cpp*
+#include "stats.h"
+
+#include <stdlib.h>
+
+namespace pbrt {
+
+#ifdef PBRT_GLOSSY_STATS
+
+static const char *GlossyLobeNames[(int)GlossyStatLobe::Count] = {
+	"DielectricReflection", "DielectricTransmission", "DielectricFresnel", "MetalReflection"
+};
+
+GlossyStatCounter GlossyStats[(int)GlossyStatLobe::Count];
+
+void ReportGlossyStats(FILE *out) {
+	fprintf(out, "{\n  \"glossy_samples\": [");
+	bool first = true;
+	for (int l = 0; l < (int)GlossyStatLobe::Count; l++) {
+		uint64_t calls = GlossyStats[l].calls.load();
+		if (calls == 0)
+			continue;
+
+		uint64_t samples = GlossyStats[l].samples.load();
+		fprintf(out, "%s\n    { \"lobe\": \"%s\", \"calls\": %llu, \"samples\": %llu, \"avg_samples\": %.2f }",
+			first ? "" : ",", GlossyLobeNames[l],
+			(unsigned long long)calls, (unsigned long long)samples, (double)samples / (double)calls);
+		first = false;
+	}
+	fprintf(out, "\n  ]\n}\n");
+}
+
+// Writes the report when the shader library is unloaded
+static struct GlossyStatReporter {
+	~GlossyStatReporter() {
+		const char *filename = getenv("SLH_GLOSSY_STATS_FILE");
+		FILE *out = filename ? fopen(filename, "w") : NULL;
+
+		ReportGlossyStats(out ? out : stderr);
+		if (out)
+			fclose(out);
+	}
+} glossyStatReporter;
+
+#else
+
+void ReportGlossyStats(FILE *out) {
+	fprintf(out, "{\n  \"glossy_samples\": []\n}\n");
+}
+
+#endif  // PBRT_GLOSSY_STATS
+
+}  // namespace pbrt
@@ -0,0 +1,64 @@
+//
+// Glossy lobe sample statistics
+//
+// Compiled out unless PBRT_GLOSSY_STATS is defined. When enabled, the glossy
+// lobes in slh_pbrt.cpp record how many samples each call took, and the
+// totals are written as JSON when the shader library is unloaded. Set
+// SLH_GLOSSY_STATS_FILE to write the report to a file instead of stderr.
+// BxDF timings are measured by bench/bxdf_bench.cpp instead.
+//
+
+#if defined(_MSC_VER)
+#define NOMINMAX
+#pragma once
+#endif
+
+#ifndef PBRT_CORE_STATS_H
+#define PBRT_CORE_STATS_H
+
+#include <stdio.h>
+
+#ifdef PBRT_GLOSSY_STATS
+#include <atomic>
+#include <cstdint>
+#endif
+
+namespace pbrt {
+
+enum class GlossyStatLobe {
+	DielectricReflection,
+	DielectricTransmission,
+	DielectricFresnel,
+	MetalReflection,
+	Count
+};
+
+// Writes the accumulated statistics as a JSON document
+void ReportGlossyStats(FILE *out);
+
+#ifdef PBRT_GLOSSY_STATS
+
+struct GlossyStatCounter {
+	std::atomic<uint64_t> calls;
+	std::atomic<uint64_t> samples;
+};
+
+extern GlossyStatCounter GlossyStats[(int)GlossyStatLobe::Count];
+
+inline void AddGlossyStat(GlossyStatLobe lobe, int samples) {
+	GlossyStats[(int)lobe].calls.fetch_add(1, std::memory_order_relaxed);
+	GlossyStats[(int)lobe].samples.fetch_add(samples, std::memory_order_relaxed);
+}
+
+#define GLOSSY_SAMPLE_STAT(lobe, samples) \
+	pbrt::AddGlossyStat(pbrt::GlossyStatLobe::lobe, samples)
+
+#else
+
+#define GLOSSY_SAMPLE_STAT(lobe, samples)
+
+#endif  // PBRT_GLOSSY_STATS
+
+}  // namespace pbrt
+
+#endif  // PBRT_CORE_STATS_H
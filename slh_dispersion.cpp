@@ -6,6 +6,45 @@ struct slh_dispersion
 	miColor		refraction_color;
 	miScalar	scatter;
 	int         samples;
+	miBoolean	spectral;
+
+	// ior model, 0 = ior + scatter offsets, 1 = Cauchy, 2 = Sellmeier. The Cauchy and Sellmeier
+	// models give the measured dispersion, ior and scatter are only read by model 0
+	int			ior_model;
+	// Sellmeier preset, 0 = the coefficients below, 1 = BK7, 2 = fused silica, 3 = SF11, 4 = sapphire, 5 = diamond
+	int			preset;
+	// n = A + B / l^2 + C / l^4, l in micrometres
+	miScalar	cauchy_a;
+	miScalar	cauchy_b;
+	miScalar	cauchy_c;
+	// n^2 = 1 + sum Bi l^2 / (l^2 - Ci), l in micrometres
+	miScalar	sellmeier_b1;
+	miScalar	sellmeier_b2;
+	miScalar	sellmeier_b3;
+	miScalar	sellmeier_c1;
+	miScalar	sellmeier_c2;
+	miScalar	sellmeier_c3;
+};
+
+enum { IOR_LINEAR, IOR_CAUCHY, IOR_SELLMEIER };
+
+// Sellmeier B1 B2 B3 C1 C2 C3 of the presets
+static const double SELLMEIER_PRESETS[][6] = {
+	{ 1.03961212, 0.231792344, 1.01046945, 0.00600069867, 0.0200179144, 103.560653 },	// BK7
+	{ 0.6961663, 0.4079426, 0.8974794, 0.00467914826, 0.0135120631, 97.9340025 },		// fused silica
+	{ 1.73759695, 0.313747346, 1.89878101, 0.013188707, 0.0623068142, 155.23629 },		// SF11
+	{ 1.4313493, 0.65054713, 5.3414021, 0.0052799261, 0.0142382647, 325.017834 },		// sapphire (ordinary ray)
+	{ 0.3306, 4.3356, 0.0, 0.030625, 0.011236, 0.0 },									// diamond
+};
+
+static const int N_LAMBDA = pbrt::sampledLambdaEnd - pbrt::sampledLambdaStart + 1;
+
+// Per instance data, the ior of every wavelength in [sampledLambdaStart, sampledLambdaEnd]
+// built once by slh_dispersion_init
+struct slh_dispersion_data {
+	int			model;
+	miScalar	ior_d;		// at the helium d line, 587.6nm, used for fresnel and undispersed rays
+	miScalar	ior[N_LAMBDA];
 };
 
 
@@ -14,11 +53,128 @@ static double lb[3] = { 0.0,0.2,0.6 };
 static double ub[3] = { 0.4,0.8,1.0 };
 static miColor RGB_VEC[3] = { RED,GRE,BLU };
 
+// used in spectral mode, RGB weight of each wavelength in [sampledLambdaStart, sampledLambdaEnd]
+// from the CIE matching functions, normalised so that an equal energy spectrum averages to white
+struct WavelengthToRGB {
+	static const int n = pbrt::sampledLambdaEnd - pbrt::sampledLambdaStart + 1;
+	miColor rgb[n];
+
+	WavelengthToRGB() {
+		miColor total = BLA;
+		for (int i = 0; i < n; i++) {
+			int cie = pbrt::sampledLambdaStart + i - (int)pbrt::CIE_lambda[0];
+			pbrt::Float xyz[3] = { pbrt::CIE_X[cie], pbrt::CIE_Y[cie], pbrt::CIE_Z[cie] }, c[3];
+			pbrt::XYZToRGB(xyz, c);
+
+			rgb[i] = { c[0], c[1], c[2], 1.f };
+			total += rgb[i];
+		}
+
+		for (int i = 0; i < n; i++) {
+			rgb[i].r *= n / total.r;
+			rgb[i].g *= n / total.g;
+			rgb[i].b *= n / total.b;
+		}
+	}
+
+	miColor operator()(miScalar lambda) const {
+		miScalar x = lambda - pbrt::sampledLambdaStart;
+		int i = std::min(std::max((int)x, 0), n - 2);
+		miScalar t = x - i;
+		return rgb[i] * (1 - t) + rgb[i + 1] * t;
+	}
+};
+
+static miScalar cauchy_ior(const double *coeffs, double lambda_um) {
+	double l2 = lambda_um * lambda_um;
+	return (miScalar)(coeffs[0] + coeffs[1] / l2 + coeffs[2] / (l2 * l2));
+}
+
+static miScalar sellmeier_ior(const double *coeffs, double lambda_um) {
+	double l2 = lambda_um * lambda_um;
+	double n2 = 1.0;
+	for (int i = 0; i < 3; i++)
+		n2 += coeffs[i] * l2 / (l2 - coeffs[i + 3]);
+	return (miScalar)std::sqrt(n2);
+}
+
+// ior of a dispersed ray, t runs from the red (0) to the blue (1) end of the spectrum
+static miScalar dispersed_ior(const slh_dispersion_data *data, miScalar ior, miScalar scatter, miScalar t) {
+	if (data->model == IOR_LINEAR)
+		return ior + scatter * t;
+
+	miScalar x = (1.0 - t) * (N_LAMBDA - 1);
+	int i = std::min((int)x, N_LAMBDA - 2);
+	return pbrt::Lerp(x - i, data->ior[i], data->ior[i + 1]);
+}
+
+static const WavelengthToRGB& wavelength_to_rgb() {
+	static const WavelengthToRGB table;
+	return table;
+}
+
+// trace a refraction ray with the given ior, falling back to reflection on total internal reflection
+static miColor trace_dispersed(miState *state, miScalar disp_ior) {
+	miVector trace_dir;
+	miColor calc = BLA;
+
+	miaux_set_state_refraction_indices(state, disp_ior);
+	if (mi_refraction_dir(&trace_dir, state, state->ior_in, state->ior))
+		mi_trace_refraction(&calc, state, &trace_dir);
+	else {
+		mi_reflection_dir(&trace_dir, state);
+		if (!mi_trace_reflection(&calc, state, &trace_dir))
+			mi_trace_environment(&calc, state, &trace_dir);
+	}
+
+	return calc;
+}
+
 
 
 extern "C" DLLEXPORT
 int slh_dispersion_version(void) { return 1; }
 
+extern "C" DLLEXPORT
+miBoolean slh_dispersion_init(miState *state, struct slh_dispersion *params, miBoolean *instance_init_required)
+{
+	if (!params) {  /* Main shader init */
+		*instance_init_required = miTRUE;
+		return miTRUE;
+	}
+
+	/* Shader instance init, the ior model parameters are only read here */
+	slh_dispersion_data *data = (slh_dispersion_data*)miaux_user_memory_pointer(state, sizeof(slh_dispersion_data));
+	data->model = *mi_eval_integer(&params->ior_model);
+
+	double coeffs[6] = { *mi_eval_scalar(&params->sellmeier_b1), *mi_eval_scalar(&params->sellmeier_b2), *mi_eval_scalar(&params->sellmeier_b3),
+		*mi_eval_scalar(&params->sellmeier_c1), *mi_eval_scalar(&params->sellmeier_c2), *mi_eval_scalar(&params->sellmeier_c3) };
+	int preset = *mi_eval_integer(&params->preset);
+	if (preset > 0 && preset <= (int)(sizeof(SELLMEIER_PRESETS) / sizeof(SELLMEIER_PRESETS[0])))
+		std::copy(SELLMEIER_PRESETS[preset - 1], SELLMEIER_PRESETS[preset - 1] + 6, coeffs);
+
+	double cauchy[3] = { *mi_eval_scalar(&params->cauchy_a), *mi_eval_scalar(&params->cauchy_b), *mi_eval_scalar(&params->cauchy_c) };
+
+	for (int i = 0; i <= N_LAMBDA; i++) {
+		// the last entry is the d line
+		double lambda_um = (i < N_LAMBDA ? pbrt::sampledLambdaStart + i : 587.6) * 0.001;
+		miScalar n = data->model == IOR_CAUCHY ? cauchy_ior(cauchy, lambda_um) : sellmeier_ior(coeffs, lambda_um);
+
+		if (i < N_LAMBDA)
+			data->ior[i] = n;
+		else
+			data->ior_d = n;
+	}
+
+	return miTRUE;
+}
+
+extern "C" DLLEXPORT
+miBoolean slh_dispersion_exit(miState *state, struct slh_dispersion *params)
+{
+	return miaux_release_user_memory("slh_dispersion", state, params);
+}
+
 extern "C" DLLEXPORT
 miBoolean slh_dispersion(miColor *result, miState *state, struct slh_dispersion *params) 
 {
@@ -28,7 +184,6 @@ miBoolean slh_dispersion(miColor *result, miState *state, struct slh_dispersion
 	}
 
 
-	miState *s = state; //save state as we'll be reset it each refract trace.
 	bool entering = miaux_ray_is_entering(state, NULL); //is ray entering material
 	
 	// variables used throughout
@@ -36,7 +191,8 @@ miBoolean slh_dispersion(miColor *result, miState *state, struct slh_dispersion
 	miVector trace_dir;
 
 	// calculate fresnel
-	miScalar	ior = *mi_eval_scalar(&params->ior);
+	const slh_dispersion_data *data = (const slh_dispersion_data*)miaux_user_memory_pointer(state, 0);
+	miScalar	ior = data->model == IOR_LINEAR ? *mi_eval_scalar(&params->ior) : data->ior_d;
 	miaux_set_state_refraction_indices(state, ior);
 	
 	mi_refraction_dir(&trace_dir, state, state->ior_in, state->ior);
@@ -56,9 +212,10 @@ miBoolean slh_dispersion(miColor *result, miState *state, struct slh_dispersion
 	// REFRACTION
 	if (!PastRefrDepth(state) && (reflect_mult.r < 1.0f || reflect_mult.g < 1.0f || reflect_mult.b < 1.0f))
 	{
-		miScalar scatter = *mi_eval_scalar(&params->scatter);
+		miScalar scatter = data->model == IOR_LINEAR ? *mi_eval_scalar(&params->scatter) : 0.f;
 
-		if (!entering || scatter <= 0.0001) { // if ray is exiting material, or scatter is too small regular refraction
+		// if ray is exiting material, or the ior + scatter model has too small a scatter, regular refraction
+		if (!entering || (data->model == IOR_LINEAR && scatter <= 0.0001)) {
 			miaux_set_state_refraction_indices(state, ior);
 
 			if (mi_refraction_dir(&trace_dir, state, state->ior_in, state->ior)) 
@@ -69,11 +226,46 @@ miBoolean slh_dispersion(miColor *result, miState *state, struct slh_dispersion
 					mi_trace_environment(&refract_res, state, &trace_dir);
 			}
 		}
+		else if (*mi_eval_boolean(&params->spectral)) { // if ray is entering, trace one wavelength per ray
+			int samples = *mi_eval_integer(&params->samples);
+			miColor refract_color = *mi_eval_color(&params->refraction_color);
+			const WavelengthToRGB &to_rgb = wavelength_to_rgb();
+
+			miColor sum = BLA;
+
+			// Each hero wavelength comes with three companions spread evenly over the visible
+			// range. The ior differs per wavelength, so every wavelength gets its own ray.
+			const miUint nSamp = std::max((samples + 3) / 4, 1);
+			double samp[1];
+
+			int sample_number = 0;
+			while (mi_sample(samp, &sample_number, state, 1, &nSamp))
+			{
+				for (int j = 0; j < 4; j++) {
+					miScalar u = *samp + 0.25 * j;
+					if (u >= 1.0)
+						u -= 1.0;
+
+					// short wavelengths get the highest ior, as the blue band of the RGB mode
+					miScalar lambda = pbrt::Lerp(u, pbrt::sampledLambdaStart, pbrt::sampledLambdaEnd);
+					miScalar disp_ior = dispersed_ior(data, ior, scatter, 1.0 - u);
+
+					sum += trace_dispersed(state, disp_ior) * to_rgb(lambda);
+				}
+			}
+
+			// refract result, the matching functions dip below zero in places
+			miScalar inv_mult = 1.0 / (miScalar)(4 * nSamp);
+			refract_res = sum * inv_mult * refract_color;
+			refract_res.r = std::max(refract_res.r, 0.f);
+			refract_res.g = std::max(refract_res.g, 0.f);
+			refract_res.b = std::max(refract_res.b, 0.f);
+		}
 		else { // if ray is entering, split refraction for RGB spliting
 			int samples = *mi_eval_integer(&params->samples);
 			miColor refract_color = *mi_eval_color(&params->refraction_color);
 
-			miColor calc = BLA, sum = BLA;
+			miColor sum = BLA;
 
 			const miUint nSamp = samples;
 			double samp[1];
@@ -84,22 +276,9 @@ miBoolean slh_dispersion(miColor *result, miState *state, struct slh_dispersion
 				int sample_number = 0;
 				while (mi_sample(samp, &sample_number, state, 1, &nSamp))
 				{
-					miScalar disp_ior = ior + scatter * miaux_fit(*samp, 0.0, 1.0, lb[i], ub[i]); // pick random IOR per color.
-
-					miaux_set_state_refraction_indices(state, disp_ior);
-					if (mi_refraction_dir(&trace_dir, state, state->ior_in, state->ior))
-						mi_trace_refraction(&calc, state, &trace_dir);
-					else {
-						mi_reflection_dir(&trace_dir, state);
-						if (!mi_trace_reflection(&calc, state, &trace_dir))
-							mi_trace_environment(&calc, state, &trace_dir);
-					}
-
-
-					sum += (calc * RGB_VEC[i]);
+					miScalar disp_ior = dispersed_ior(data, ior, scatter, miaux_fit(*samp, 0.0, 1.0, lb[i], ub[i])); // pick random IOR per color.
 
-					state = s;
-					calc = BLA;
+					sum += (trace_dispersed(state, disp_ior) * RGB_VEC[i]);
 				}
 			}
 
@@ -1,4 +1,5 @@
 #include "slh_aux.h"
+#include "core/rng.h"
 
 struct shader_list {
 	miScalar	weight;
@@ -11,6 +12,7 @@ struct slh_layer
 	int			n_list;
 	shader_list s_list[1];
 	miVector	bump;
+	miBoolean	stochastic;
 };
 
 extern "C" DLLEXPORT
@@ -31,6 +33,56 @@ miBoolean slh_layer(miColor *result, miState *state, struct slh_layer *params)
 
 	miColor res = BLA;
 
+	if (*mi_eval_boolean(&params->stochastic)) {
+		// Pick one layer per sample with probability proportional to its effective weight,
+		// in a single pass, and scale its result by the summed weight to stay unbiased
+		double samp;
+		int sample_number = 0, taken = 0;
+		miUint nSamp = 1;
+
+		// The picked layer is shaded inside the iteration that drew it, so
+		// the loop runs to completion before the shader returns
+		while (mi_sample(&samp, &sample_number, state, 1, &nSamp)) {
+			miScalar u = (miScalar)samp;
+			miScalar totalWeight = 1.0, weightSum = 0.0;
+			miTag picked = miNULLTAG;
+			taken++;
+
+			for (int i = 0; i < n_off && totalWeight > 0.f; i++) {
+				shader_list *ts = &params->s_list[i + i_off];
+				miScalar weight = *mi_eval_scalar(&ts->weight);
+
+				if (weight > 0.f) {
+					miScalar layerWeight = totalWeight * weight;
+					weightSum += layerWeight;
+					totalWeight *= 1.f - weight;
+
+					// Keep this layer with probability layerWeight / weightSum, reusing u
+					miScalar p = layerWeight / weightSum;
+					if (u < p) {
+						picked = *mi_eval_tag(&ts->shader);
+						u = std::min(u / p, pbrt::OneMinusEpsilon);
+					}
+					else {
+						u = std::min((u - p) / (1.f - p), pbrt::OneMinusEpsilon);
+					}
+				}
+			}
+
+			if (picked != miNULLTAG) {
+				miColor shader_res;
+				mi_call_shader(&shader_res, miSHADER_MATERIAL, state, picked);
+				res += shader_res * weightSum;
+			}
+		}
+
+		if (taken > 1)
+			res = res * (1.f / taken);
+
+		*result = res;
+		return miTRUE;
+	}
+
 	// Loop over shaders 
 	miScalar totalWeight = 1.0; //total possible percentage of cuuent layer
 	for (int i = 0; i < n_off; i++) {
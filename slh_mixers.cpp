@@ -1,5 +1,8 @@
 #include "slh_aux.h"
 
+#include <cstddef>
+#include <cstring>
+
 //
 //MIX COLORS
 //
@@ -275,240 +278,273 @@ struct slh_mix_mia_in
     struct      slh_mix_mia B;
 };
 
-extern "C" DLLEXPORT
-miBoolean slh_mix_mia(struct slh_mix_mia *result, miState *state, struct slh_mix_mia_in *params)
+// Every field of slh_mix_mia with its type, so both sides can be evaluated and
+// mixed field by field. Fields that mia_material ignores unless a toggle is set
+// name that toggle, and are only evaluated when it is set on a side in use.
+enum slh_mix_type { MIX_SCALAR, MIX_COLOR, MIX_INT, MIX_BOOL };
+enum slh_mix_gate { GATE_NONE, GATE_ON, GATE_OFF, GATE_NOT_ONE };
+
+struct slh_mix_field
+{
+    size_t          offset;
+    slh_mix_type    type;
+    slh_mix_gate    gate;
+    size_t          gate_offset;
+};
+
+#define MIX_FIELD(name, type) { offsetof(struct slh_mix_mia, name), type, GATE_NONE, 0 }
+#define MIX_GATED(name, type, gate, toggle) { offsetof(struct slh_mix_mia, name), type, gate, offsetof(struct slh_mix_mia, toggle) }
+
+static const slh_mix_field mia_fields[] =
+{
+    MIX_FIELD(diffuse_weight, MIX_SCALAR),
+    MIX_FIELD(diffuse, MIX_COLOR),
+    MIX_FIELD(diffuse_roughness, MIX_SCALAR),
+
+    MIX_FIELD(reflectivity, MIX_SCALAR),
+    MIX_FIELD(refl_color, MIX_COLOR),
+    MIX_FIELD(refl_gloss, MIX_SCALAR),
+    MIX_FIELD(refl_gloss_samples, MIX_INT),
+    MIX_FIELD(refl_interpolate, MIX_BOOL),
+    MIX_FIELD(refl_hl_only, MIX_BOOL),
+    MIX_FIELD(refl_is_metal, MIX_BOOL),
+
+    MIX_FIELD(transparency, MIX_SCALAR),
+    MIX_FIELD(refr_color, MIX_COLOR),
+    MIX_FIELD(refr_gloss, MIX_SCALAR),
+    MIX_FIELD(refr_ior, MIX_SCALAR),
+    MIX_FIELD(refr_gloss_samples, MIX_INT),
+    MIX_FIELD(refr_interpolate, MIX_BOOL),
+    MIX_FIELD(refr_translucency, MIX_BOOL),
+    MIX_GATED(refr_trans_color, MIX_COLOR, GATE_ON, refr_translucency),
+    MIX_GATED(refr_trans_weight, MIX_SCALAR, GATE_ON, refr_translucency),
+
+    MIX_FIELD(anisotropy, MIX_SCALAR),
+    MIX_GATED(anisotropy_rotation, MIX_SCALAR, GATE_NOT_ONE, anisotropy),
+    MIX_GATED(anisotropy_channel, MIX_INT, GATE_NOT_ONE, anisotropy),
+
+    MIX_FIELD(brdf_fresnel, MIX_BOOL),
+    MIX_GATED(brdf_0_degree_refl, MIX_SCALAR, GATE_OFF, brdf_fresnel),
+    MIX_GATED(brdf_90_degree_refl, MIX_SCALAR, GATE_OFF, brdf_fresnel),
+    MIX_GATED(brdf_curve, MIX_SCALAR, GATE_OFF, brdf_fresnel),
+    MIX_FIELD(brdf_conserve_energy, MIX_BOOL),
+
+    // Reflection/Refraction optimizations & falloffs
+
+    MIX_FIELD(refl_falloff_on, MIX_BOOL),
+    MIX_GATED(refl_falloff_dist, MIX_SCALAR, GATE_ON, refl_falloff_on),
+    MIX_GATED(refl_falloff_color_on, MIX_BOOL, GATE_ON, refl_falloff_on),
+    MIX_GATED(refl_falloff_color, MIX_COLOR, GATE_ON, refl_falloff_color_on),
+    MIX_FIELD(refl_depth, MIX_INT),
+    MIX_FIELD(refl_cutoff, MIX_SCALAR),
+
+    MIX_FIELD(refr_falloff_on, MIX_BOOL),
+    MIX_GATED(refr_falloff_dist, MIX_SCALAR, GATE_ON, refr_falloff_on),
+    MIX_GATED(refr_falloff_color_on, MIX_BOOL, GATE_ON, refr_falloff_on),
+    MIX_GATED(refr_falloff_color, MIX_COLOR, GATE_ON, refr_falloff_color_on),
+    MIX_FIELD(refr_depth, MIX_INT),
+    MIX_FIELD(refr_cutoff, MIX_SCALAR),
+
+    // Built in AO
+
+    MIX_FIELD(ao_on, MIX_BOOL),
+    MIX_GATED(ao_samples, MIX_INT, GATE_ON, ao_on),
+    MIX_GATED(ao_distance, MIX_SCALAR, GATE_ON, ao_on),
+    MIX_GATED(ao_dark, MIX_COLOR, GATE_ON, ao_on),
+    MIX_GATED(ao_ambient, MIX_COLOR, GATE_ON, ao_on),
+    MIX_GATED(ao_do_details, MIX_INT, GATE_ON, ao_on),
+
+    // Options
+
+    MIX_FIELD(thin_walled, MIX_BOOL),
+    MIX_FIELD(no_visible_area_hl, MIX_BOOL),
+    MIX_FIELD(skip_inside_refl, MIX_BOOL),
+    MIX_FIELD(do_refractive_caustics, MIX_BOOL),
+    MIX_FIELD(backface_cull, MIX_BOOL),
+    MIX_FIELD(propagate_alpha, MIX_BOOL),
+
+    // Other effects
+
+    MIX_FIELD(hl_vs_refl_balance, MIX_SCALAR),
+    MIX_FIELD(cutout_opacity, MIX_SCALAR),
+    MIX_FIELD(additional_color, MIX_COLOR),
+};
+
+static const int mia_field_count = sizeof(mia_fields) / sizeof(mia_fields[0]);
+
+// Writes the mix of one field of A and B into result
+static void mixField(const slh_mix_field &field, void *result, const void *A, const void *B, miScalar mask)
+{
+    miScalar blend = 1.0 - mask;
+
+    switch (field.type) {
+    case MIX_SCALAR:
+        *(miScalar*)result = mixScalar(*(const miScalar*)A, *(const miScalar*)B, mask, blend);
+        break;
+    case MIX_COLOR:
+        *(miColor*)result = mixColor(*(const miColor*)A, *(const miColor*)B, mask, blend);
+        break;
+    case MIX_INT:
+        *(int*)result = mixInt(*(const int*)A, *(const int*)B, mask, blend);
+        break;
+    case MIX_BOOL:
+        *(miBoolean*)result = mixBool(*(const miBoolean*)A, *(const miBoolean*)B, mask);
+        break;
+    }
+}
+
+// Whether a gated field is needed, given the value of its toggle on one side
+static bool gateOpen(const slh_mix_field &field, const void *toggle)
+{
+    if (!toggle)
+        return false;
+
+    switch (field.gate) {
+    case GATE_ON: return *(const miBoolean*)toggle != miFALSE;
+    case GATE_OFF: return *(const miBoolean*)toggle == miFALSE;
+    case GATE_NOT_ONE: return *(const miScalar*)toggle != 1.0;
+    default: return true;
+    }
+}
+
+static size_t fieldSize(const slh_mix_field &field)
+{
+    switch (field.type) {
+    case MIX_SCALAR: return sizeof(miScalar);
+    case MIX_COLOR: return sizeof(miColor);
+    case MIX_INT: return sizeof(int);
+    default: return sizeof(miBoolean);
+    }
+}
+
+// Clamps the mask and widens the pure A / pure B ends
+static miScalar mixMask(miScalar mask)
 {
-    miScalar mask = *mi_eval_scalar(&params->mask);
     if (mask>1.0){mask=1.0;}
     else if (mask<0.0){mask=0.0;}
-    
-    mask = (mask-0.05)/0.9;
 
-    //mi_info("mixer_called");
-    if (mask >= 1.0)
-    {
-        result->diffuse_weight = *mi_eval_scalar(&params->A.diffuse_weight);
-        result->diffuse = *mi_eval_color(&params->A.diffuse);
-        result->diffuse_roughness = *mi_eval_scalar(&params->A.diffuse_roughness);
-        
-        result->reflectivity = *mi_eval_scalar(&params->A.reflectivity);
-        result->refl_color = *mi_eval_color(&params->A.refl_color);
-        result->refl_gloss = *mi_eval_scalar(&params->A.refl_gloss);
-        result->refl_gloss_samples = *mi_eval_integer(&params->A.refl_gloss_samples);
-        result->refl_interpolate = *mi_eval_boolean(&params->A.refl_interpolate);
-        result->refl_hl_only = *mi_eval_boolean(&params->A.refl_hl_only);
-        result->refl_is_metal = *mi_eval_boolean(&params->A.refl_is_metal);
-        
-        result->transparency = *mi_eval_scalar(&params->A.transparency);
-        result->refr_color = *mi_eval_color(&params->A.refr_color);
-        result->refr_gloss = *mi_eval_scalar(&params->A.refr_gloss);
-        result->refr_ior = *mi_eval_scalar(&params->A.refr_ior);
-        result->refr_gloss_samples = *mi_eval_integer(&params->A.refr_gloss_samples);
-        result->refr_interpolate = *mi_eval_boolean(&params->A.refr_interpolate);
-        result->refr_translucency = *mi_eval_boolean(&params->A.refr_translucency);
-        result->refr_trans_color = *mi_eval_color(&params->A.refr_trans_color);
-        result->refr_trans_weight = *mi_eval_scalar(&params->A.refr_trans_weight);
-        
-        result->anisotropy = *mi_eval_scalar(&params->A.anisotropy);
-        result->anisotropy_rotation = *mi_eval_scalar(&params->A.anisotropy_rotation);
-        result->anisotropy_channel = *mi_eval_integer(&params->A.anisotropy_channel);
-        
-        result->brdf_fresnel = *mi_eval_boolean(&params->A.brdf_fresnel);
-        result->brdf_0_degree_refl = *mi_eval_scalar(&params->A.brdf_0_degree_refl);
-        result->brdf_90_degree_refl = *mi_eval_scalar(&params->A.brdf_90_degree_refl);
-        result->brdf_curve = *mi_eval_scalar(&params->A.brdf_curve);
-        result->brdf_conserve_energy = *mi_eval_boolean(&params->A.brdf_conserve_energy);
-        
-        // Reflection/Refraction optimizations & falloffs
-        
-        result->refl_falloff_on = *mi_eval_boolean(&params->A.refl_falloff_on);
-        result->refl_falloff_dist = *mi_eval_scalar(&params->A.refl_falloff_dist);
-        result->refl_falloff_color_on = *mi_eval_boolean(&params->A.refl_falloff_color_on);
-        result->refl_falloff_color = *mi_eval_color(&params->A.refr_trans_color);
-        result->refl_depth = *mi_eval_integer(&params->A.refl_depth);
-        result->refl_cutoff = *mi_eval_scalar(&params->A.refl_cutoff);
-        
-        result->refr_falloff_on = *mi_eval_boolean(&params->A.refr_falloff_on);
-        result->refr_falloff_dist = *mi_eval_scalar(&params->A.refr_falloff_dist);
-        result->refr_falloff_color_on = *mi_eval_boolean(&params->A.refr_falloff_color_on);
-        result->refr_falloff_color = *mi_eval_color(&params->A.refr_falloff_color);
-        result->refr_depth = *mi_eval_integer(&params->A.refr_depth);
-        result->refr_cutoff = *mi_eval_scalar(&params->A.refr_cutoff);
-        
-        // Built in AO
-        
-        result->ao_on = *mi_eval_boolean(&params->A.ao_on);
-        result->ao_samples = *mi_eval_integer(&params->A.ao_samples);
-        result->ao_distance = *mi_eval_scalar(&params->A.ao_distance);
-        result->ao_dark = *mi_eval_color(&params->A.ao_dark);
-        result->ao_ambient = *mi_eval_color(&params->A.ao_ambient);
-        result->ao_do_details = *mi_eval_integer(&params->A.ao_do_details);
-        
-        // Options
-        
-        result->thin_walled = *mi_eval_boolean(&params->A.thin_walled);
-        result->no_visible_area_hl = *mi_eval_boolean(&params->A.no_visible_area_hl);
-        result->skip_inside_refl = *mi_eval_boolean(&params->A.skip_inside_refl);
-        result->do_refractive_caustics = *mi_eval_boolean(&params->A.do_refractive_caustics);
-        result->backface_cull = *mi_eval_boolean(&params->A.backface_cull);
-        result->propagate_alpha = *mi_eval_boolean(&params->A.propagate_alpha);
-        
-        // Other effects
-        
-        result->hl_vs_refl_balance = *mi_eval_scalar(&params->A.hl_vs_refl_balance);
-        result->cutout_opacity = *mi_eval_scalar(&params->A.cutout_opacity);
-        result->additional_color = *mi_eval_color(&params->A.additional_color);
+    return (mask-0.05)/0.9;
+}
+
+// Per instance data, filled in by slh_mix_mia_init. A parameter is constant when
+// mi_eval returns the parameter itself, i.e. no shader is connected to it.
+struct slh_mix_mia_data
+{
+    miBoolean           mask_const;
+    miScalar            mask;
+    miBoolean           A_const[mia_field_count];
+    miBoolean           B_const[mia_field_count];
+    int                 gate_index[mia_field_count];
+
+    // With a constant mask, every field whose inputs are constant is mixed once here
+    struct slh_mix_mia  folded;
+    miBoolean           is_folded[mia_field_count];
+};
+
+extern "C" DLLEXPORT
+miBoolean slh_mix_mia_init(miState *state, struct slh_mix_mia_in *params, miBoolean *instance_init_required)
+{
+    if (!params) {  /* Main shader init */
+        *instance_init_required = miTRUE;
+        return miTRUE;
     }
-    else if (mask <= 0.0)
-    {
-        result->diffuse_weight = *mi_eval_scalar(&params->B.diffuse_weight);
-        result->diffuse = *mi_eval_color(&params->B.diffuse);
-        result->diffuse_roughness = *mi_eval_scalar(&params->B.diffuse_roughness);
-        
-        result->reflectivity = *mi_eval_scalar(&params->B.reflectivity);
-        result->refl_color = *mi_eval_color(&params->B.refl_color);
-        result->refl_gloss = *mi_eval_scalar(&params->B.refl_gloss);
-        result->refl_gloss_samples = *mi_eval_integer(&params->B.refl_gloss_samples);
-        result->refl_interpolate = *mi_eval_boolean(&params->B.refl_interpolate);
-        result->refl_hl_only = *mi_eval_boolean(&params->B.refl_hl_only);
-        result->refl_is_metal = *mi_eval_boolean(&params->B.refl_is_metal);
-        
-        result->transparency = *mi_eval_scalar(&params->B.transparency);
-        result->refr_color = *mi_eval_color(&params->B.refr_color);
-        result->refr_gloss = *mi_eval_scalar(&params->B.refr_gloss);
-        result->refr_ior = *mi_eval_scalar(&params->B.refr_ior);
-        result->refr_gloss_samples = *mi_eval_integer(&params->B.refr_gloss_samples);
-        result->refr_interpolate = *mi_eval_boolean(&params->B.refr_interpolate);
-        result->refr_translucency = *mi_eval_boolean(&params->B.refr_translucency);
-        result->refr_trans_color = *mi_eval_color(&params->B.refr_trans_color);
-        result->refr_trans_weight = *mi_eval_scalar(&params->B.refr_trans_weight);
-        
-        result->anisotropy = *mi_eval_scalar(&params->B.anisotropy);
-        result->anisotropy_rotation = *mi_eval_scalar(&params->B.anisotropy_rotation);
-        result->anisotropy_channel = *mi_eval_integer(&params->B.anisotropy_channel);
-        
-        result->brdf_fresnel = *mi_eval_boolean(&params->B.brdf_fresnel);
-        result->brdf_0_degree_refl = *mi_eval_scalar(&params->B.brdf_0_degree_refl);
-        result->brdf_90_degree_refl = *mi_eval_scalar(&params->B.brdf_90_degree_refl);
-        result->brdf_curve = *mi_eval_scalar(&params->B.brdf_curve);
-        result->brdf_conserve_energy = *mi_eval_boolean(&params->B.brdf_conserve_energy);
-        
-        // Reflection/Refraction optimizations & falloffs
-        
-        result->refl_falloff_on = *mi_eval_boolean(&params->B.refl_falloff_on);
-        result->refl_falloff_dist = *mi_eval_scalar(&params->B.refl_falloff_dist);
-        result->refl_falloff_color_on = *mi_eval_boolean(&params->B.refl_falloff_color_on);
-        result->refl_falloff_color = *mi_eval_color(&params->B.refr_trans_color);
-        result->refl_depth = *mi_eval_integer(&params->B.refl_depth);
-        result->refl_cutoff = *mi_eval_scalar(&params->B.refl_cutoff);
-        
-        result->refr_falloff_on = *mi_eval_boolean(&params->B.refr_falloff_on);
-        result->refr_falloff_dist = *mi_eval_scalar(&params->B.refr_falloff_dist);
-        result->refr_falloff_color_on = *mi_eval_boolean(&params->B.refr_falloff_color_on);
-        result->refr_falloff_color = *mi_eval_color(&params->B.refr_falloff_color);
-        result->refr_depth = *mi_eval_integer(&params->B.refr_depth);
-        result->refr_cutoff = *mi_eval_scalar(&params->B.refr_cutoff);
-        
-        // Built in AO
-        
-        result->ao_on = *mi_eval_boolean(&params->B.ao_on);
-        result->ao_samples = *mi_eval_integer(&params->B.ao_samples);
-        result->ao_distance = *mi_eval_scalar(&params->B.ao_distance);
-        result->ao_dark = *mi_eval_color(&params->B.ao_dark);
-        result->ao_ambient = *mi_eval_color(&params->B.ao_ambient);
-        result->ao_do_details = *mi_eval_integer(&params->B.ao_do_details);
-        
-        // Options
-        
-        result->thin_walled = *mi_eval_boolean(&params->B.thin_walled);
-        result->no_visible_area_hl = *mi_eval_boolean(&params->B.no_visible_area_hl);
-        result->skip_inside_refl = *mi_eval_boolean(&params->B.skip_inside_refl);
-        result->do_refractive_caustics = *mi_eval_boolean(&params->B.do_refractive_caustics);
-        result->backface_cull = *mi_eval_boolean(&params->B.backface_cull);
-        result->propagate_alpha = *mi_eval_boolean(&params->B.propagate_alpha);
-        
-        // Other effects
-        
-        result->hl_vs_refl_balance = *mi_eval_scalar(&params->B.hl_vs_refl_balance);
-        result->cutout_opacity = *mi_eval_scalar(&params->B.cutout_opacity);
-        result->additional_color = *mi_eval_color(&params->B.additional_color);
 
+    /* Shader instance init */
+    slh_mix_mia_data *data = (slh_mix_mia_data*)miaux_user_memory_pointer(state, sizeof(slh_mix_mia_data));
+
+    miScalar *mask = mi_eval_scalar(&params->mask);
+    data->mask_const = mask == &params->mask;
+    data->mask = mixMask(*mask);
+
+    for (int i = 0; i < mia_field_count; i++) {
+        const slh_mix_field &field = mia_fields[i];
+        char *A = (char*)&params->A + field.offset;
+        char *B = (char*)&params->B + field.offset;
+
+        data->A_const[i] = mi_eval(state, A) == A;
+        data->B_const[i] = mi_eval(state, B) == B;
+
+        // Toggles come before the fields they gate
+        data->gate_index[i] = -1;
+        for (int j = 0; j < i && field.gate != GATE_NONE; j++) {
+            if (mia_fields[j].offset == field.gate_offset)
+                data->gate_index[i] = j;
+        }
+
+        // Only the sides the constant mask selects need to be constant
+        data->is_folded[i] = data->mask_const &&
+            (data->mask <= 0.0 || data->A_const[i]) &&
+            (data->mask >= 1.0 || data->B_const[i]);
+
+        if (data->is_folded[i]) {
+            char *folded = (char*)&data->folded + field.offset;
+
+            if (data->mask >= 1.0)
+                memcpy(folded, A, fieldSize(field));
+            else if (data->mask <= 0.0)
+                memcpy(folded, B, fieldSize(field));
+            else
+                mixField(field, folded, A, B, data->mask);
+        }
     }
-    else
-    {
-        miScalar blend = 1.0 - mask;
-        
-        result->diffuse_weight = mixScalar(*mi_eval_scalar(&params->A.diffuse_weight),*mi_eval_scalar(&params->B.diffuse_weight), mask, blend);
-        result->diffuse = mixColor(*mi_eval_color(&params->A.diffuse), *mi_eval_color(&params->B.diffuse), mask, blend);
-        result->diffuse_roughness = mixScalar(*mi_eval_scalar(&params->A.diffuse_roughness),*mi_eval_scalar(&params->B.diffuse_roughness), mask, blend);
-        
-        result->reflectivity = mixScalar(*mi_eval_scalar(&params->A.reflectivity),*mi_eval_scalar(&params->B.reflectivity), mask, blend);
-        result->refl_color = mixColor(*mi_eval_color(&params->A.refl_color),*mi_eval_color(&params->B.refl_color), mask, blend);
-        result->refl_gloss = mixScalar(*mi_eval_scalar(&params->A.refl_gloss),*mi_eval_scalar(&params->B.refl_gloss), mask, blend);
-        result->refl_gloss_samples = mixInt(*mi_eval_integer(&params->A.refl_gloss_samples),*mi_eval_integer(&params->B.refl_gloss_samples), mask, blend);
-        result->refl_interpolate = mixBool(*mi_eval_boolean(&params->A.refl_interpolate),*mi_eval_boolean(&params->B.refl_interpolate), mask);
-        result->refl_hl_only = mixBool(*mi_eval_boolean(&params->A.refl_hl_only),*mi_eval_boolean(&params->B.refl_hl_only), mask);
-        result->refl_is_metal = mixBool(*mi_eval_boolean(&params->A.refl_is_metal),*mi_eval_boolean(&params->B.refl_is_metal), mask);
-        
-        result->transparency = mixScalar(*mi_eval_scalar(&params->A.transparency),*mi_eval_scalar(&params->B.transparency), mask, blend);
-        result->refr_color = mixColor(*mi_eval_color(&params->A.refr_color),*mi_eval_color(&params->B.refr_color), mask, blend);
-        result->refr_gloss = mixScalar(*mi_eval_scalar(&params->A.refr_gloss),*mi_eval_scalar(&params->B.refr_gloss), mask, blend);
-        result->refr_ior = mixScalar(*mi_eval_scalar(&params->A.refr_ior),*mi_eval_scalar(&params->B.refr_ior), mask, blend);
-        result->refr_gloss_samples = mixInt(*mi_eval_integer(&params->A.refr_gloss_samples),*mi_eval_integer(&params->B.refr_gloss_samples), mask, blend);
-        result->refr_interpolate = mixBool(*mi_eval_boolean(&params->A.refr_interpolate),*mi_eval_boolean(&params->B.refr_interpolate), mask);
-        result->refr_translucency = mixBool(*mi_eval_boolean(&params->A.refr_translucency),*mi_eval_boolean(&params->B.refr_translucency), mask);
-        result->refr_trans_color = mixColor(*mi_eval_color(&params->A.refr_trans_color),*mi_eval_color(&params->B.refr_trans_color), mask, blend);
-        result->refr_trans_weight = mixScalar(*mi_eval_scalar(&params->A.refr_trans_weight),*mi_eval_scalar(&params->B.refr_trans_weight), mask, blend);
-        
-        result->anisotropy = mixScalar(*mi_eval_scalar(&params->A.anisotropy),*mi_eval_scalar(&params->B.anisotropy), mask, blend);
-        result->anisotropy_rotation = mixScalar(*mi_eval_scalar(&params->A.anisotropy_rotation),*mi_eval_scalar(&params->B.anisotropy_rotation), mask, blend);
-        result->anisotropy_channel = mixInt(*mi_eval_integer(&params->A.anisotropy_channel),*mi_eval_integer(&params->B.anisotropy_channel), mask, blend);
-        
-        result->brdf_fresnel = mixBool(*mi_eval_boolean(&params->A.brdf_fresnel),*mi_eval_boolean(&params->B.brdf_fresnel), mask);
-        result->brdf_0_degree_refl = mixScalar(*mi_eval_scalar(&params->A.brdf_0_degree_refl),*mi_eval_scalar(&params->B.brdf_0_degree_refl), mask, blend);
-        result->brdf_90_degree_refl = mixScalar(*mi_eval_scalar(&params->A.brdf_90_degree_refl),*mi_eval_scalar(&params->B.brdf_90_degree_refl), mask, blend);
-        result->brdf_curve = mixScalar(*mi_eval_scalar(&params->A.brdf_curve),*mi_eval_scalar(&params->B.brdf_curve), mask, blend);
-        result->brdf_conserve_energy = mixBool(*mi_eval_boolean(&params->A.brdf_conserve_energy),*mi_eval_boolean(&params->B.brdf_conserve_energy), mask);
-        
-        // Reflection/Refraction optimizations & falloffs
-        
-        result->refl_falloff_on = mixBool(*mi_eval_boolean(&params->A.refl_falloff_on),*mi_eval_boolean(&params->B.refl_falloff_on), mask);
-        result->refl_falloff_dist = mixScalar(*mi_eval_scalar(&params->A.refl_falloff_dist),*mi_eval_scalar(&params->B.refl_falloff_dist), mask, blend);
-        result->refl_falloff_color_on = mixBool(*mi_eval_boolean(&params->A.refl_falloff_color_on),*mi_eval_boolean(&params->B.refl_falloff_color_on), mask);
-        result->refl_falloff_color = mixColor(*mi_eval_color(&params->A.refr_trans_color),*mi_eval_color(&params->B.refr_trans_color), mask, blend);
-        result->refl_depth = mixInt(*mi_eval_integer(&params->A.refl_depth),*mi_eval_integer(&params->B.refl_depth), mask, blend);
-        result->refl_cutoff = mixScalar(*mi_eval_scalar(&params->A.refl_cutoff),*mi_eval_scalar(&params->B.refl_cutoff), mask, blend);
-        
-        result->refr_falloff_on = mixBool(*mi_eval_boolean(&params->A.refr_falloff_on),*mi_eval_boolean(&params->B.refr_falloff_on), mask);
-        result->refr_falloff_dist = mixScalar(*mi_eval_scalar(&params->A.refr_falloff_dist),*mi_eval_scalar(&params->B.refr_falloff_dist), mask, blend);
-        result->refr_falloff_color_on = mixBool(*mi_eval_boolean(&params->A.refr_falloff_color_on),*mi_eval_boolean(&params->B.refr_falloff_color_on), mask);
-        result->refr_falloff_color = mixColor(*mi_eval_color(&params->A.refr_falloff_color),*mi_eval_color(&params->B.refr_falloff_color), mask, blend);
-        result->refr_depth = mixInt(*mi_eval_integer(&params->A.refr_depth),*mi_eval_integer(&params->B.refr_depth), mask, blend);
-        result->refr_cutoff = mixScalar(*mi_eval_scalar(&params->A.refr_cutoff),*mi_eval_scalar(&params->B.refr_cutoff), mask, blend);
-        
-        // Built in AO
-        
-        result->ao_on = mixBool(*mi_eval_boolean(&params->A.ao_on),*mi_eval_boolean(&params->B.ao_on), mask);
-        result->ao_samples = mixInt(*mi_eval_integer(&params->A.ao_samples),*mi_eval_integer(&params->B.ao_samples), mask, blend);
-        result->ao_distance = mixScalar(*mi_eval_scalar(&params->A.ao_distance),*mi_eval_scalar(&params->B.ao_distance), mask, blend);
-        result->ao_dark = mixColor(*mi_eval_color(&params->A.ao_dark),*mi_eval_color(&params->B.ao_dark), mask, blend);
-        result->ao_ambient = mixColor(*mi_eval_color(&params->A.ao_ambient),*mi_eval_color(&params->B.ao_ambient), mask, blend);
-        result->ao_do_details = mixInt(*mi_eval_integer(&params->A.ao_do_details),*mi_eval_integer(&params->B.ao_do_details), mask, blend);
-        
-        // Options
-        
-        result->thin_walled = mixBool(*mi_eval_boolean(&params->A.thin_walled),*mi_eval_boolean(&params->B.thin_walled), mask);
-        result->no_visible_area_hl = mixBool(*mi_eval_boolean(&params->A.no_visible_area_hl),*mi_eval_boolean(&params->B.no_visible_area_hl), mask);
-        result->skip_inside_refl = mixBool(*mi_eval_boolean(&params->A.skip_inside_refl),*mi_eval_boolean(&params->B.skip_inside_refl), mask);
-        result->do_refractive_caustics = mixBool(*mi_eval_boolean(&params->A.do_refractive_caustics),*mi_eval_boolean(&params->B.do_refractive_caustics), mask);
-        result->backface_cull = mixBool(*mi_eval_boolean(&params->A.backface_cull),*mi_eval_boolean(&params->B.backface_cull), mask);
-        result->propagate_alpha = mixBool(*mi_eval_boolean(&params->A.propagate_alpha),*mi_eval_boolean(&params->B.propagate_alpha), mask);
-        
-        // Other effects
-        
-        result->hl_vs_refl_balance = mixScalar(*mi_eval_scalar(&params->A.hl_vs_refl_balance),*mi_eval_scalar(&params->B.hl_vs_refl_balance), mask, blend);
-        result->cutout_opacity = mixScalar(*mi_eval_scalar(&params->A.cutout_opacity),*mi_eval_scalar(&params->B.cutout_opacity), mask, blend);
-        result->additional_color = mixColor(*mi_eval_color(&params->A.additional_color),*mi_eval_color(&params->B.additional_color), mask, blend);
+
+    return miTRUE;
+}
+
+extern "C" DLLEXPORT
+miBoolean slh_mix_mia_exit(miState *state, struct slh_mix_mia_in *params)
+{
+    return miaux_release_user_memory("slh_mix_mia", state, params);
+}
+
+extern "C" DLLEXPORT
+miBoolean slh_mix_mia(struct slh_mix_mia *result, miState *state, struct slh_mix_mia_in *params)
+{
+    const slh_mix_mia_data *data = (const slh_mix_mia_data*)miaux_user_memory_pointer(state, 0);
+
+    miScalar mask = data->mask_const ? data->mask : mixMask(*mi_eval_scalar(&params->mask));
+
+    if (data->mask_const)
+        *result = data->folded;
+
+    // Values of the fields evaluated so far, NULL where a side is unused or skipped
+    const void *A_val[mia_field_count];
+    const void *B_val[mia_field_count];
+    bool use_A = mask > 0.0, use_B = mask < 1.0;
+
+    //mi_info("mixer_called");
+    for (int i = 0; i < mia_field_count; i++) {
+        const slh_mix_field &field = mia_fields[i];
+        char *out = (char*)result + field.offset;
+        char *A = (char*)&params->A + field.offset;
+        char *B = (char*)&params->B + field.offset;
+
+        A_val[i] = B_val[i] = NULL;
+
+        // Skip the field, and whatever is connected to it, when its toggle is
+        // off on every side in use
+        int gate = data->gate_index[i];
+        if (gate >= 0 && !gateOpen(field, A_val[gate]) && !gateOpen(field, B_val[gate])) {
+            if (!(data->mask_const && data->is_folded[i]))
+                memset(out, 0, fieldSize(field));
+            continue;
+        }
+
+        if (use_A)
+            A_val[i] = data->A_const[i] ? A : mi_eval(state, A);
+        if (use_B)
+            B_val[i] = data->B_const[i] ? B : mi_eval(state, B);
+
+        if (data->mask_const && data->is_folded[i])
+            continue;
+
+        if (!use_B)
+            memcpy(out, A_val[i], fieldSize(field));
+        else if (!use_A)
+            memcpy(out, B_val[i], fieldSize(field));
+        else
+            mixField(field, out, A_val[i], B_val[i], mask);
     }
+
     return miTRUE;
 }
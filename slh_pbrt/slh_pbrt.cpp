@@ -1,17 +1,278 @@
 #include "slh_pbrt.h"
 #include "reflection.h"
+#include "stats.h"
+#include "sampling.h"
+#include <mi_shader_if.h>
 
 using namespace std;
 using namespace pbrt;
 
+static const SampleBudget default_budget = { 0.5f, 1, false, 0 };
+
+SampleBudget SampleBudget::FromOptions(miState *state) {
+	SampleBudget budget = default_budget;
+
+	mi::shader::Interface *iface = mi_get_shader_interface();
+	mi::shader::Options *options = iface->getOptions(state->options->string_options);
+	options->get("slh_glossy_falloff", &budget.falloff);
+	options->get("slh_glossy_max_level", &budget.max_level);
+	options->get("slh_glossy_throughput", &budget.throughput);
+	options->get("slh_glossy_cap", &budget.cap);
+	options->release();
+	iface->release();
+
+	budget.falloff = Clamp(budget.falloff, 0.f, 1.f);
+	return budget;
+}
+
+miUint SampleBudget::Samples(const miState *state, int samples) const {
+	int level = state->reflection_level + state->refraction_level;
+	if (level > max_level)
+		return 1;
+
+	miScalar n = samples * std::pow(falloff, (miScalar)level);
+	if (throughput)
+		n *= Clamp(state->importance, 0.f, 1.f);
+
+	int nSamp = std::max((int)n, 1);
+	return cap > 0 ? std::min(nSamp, cap) : nSamp;
+}
+
+// Area light shapes as numbered by miQ_LIGHT_AREA
+enum { LIGHT_AREA_NONE = 0, LIGHT_AREA_RECTANGLE = 1, LIGHT_AREA_DISC = 2 };
+
+bool MISLight::Init(miState *state, miTag light_instance) {
+	miTag light = miNULLTAG;
+	type = LIGHT_AREA_NONE;
+	samples = 0;
+	area = 0.f;
+
+	if (!mi_query(miQ_INST_ITEM, state, light_instance, &light) || !mi_query(miQ_LIGHT_AREA, state, light, &type))
+		return false;
+	if (type == LIGHT_AREA_NONE)
+		return true;
+	if (type != LIGHT_AREA_RECTANGLE && type != LIGHT_AREA_DISC)
+		return false;
+
+	// The shape is given in light space, the rectangle is centered on the origin
+	miVector l_origin, l_u, l_v, l_normal;
+	mi_query(miQ_LIGHT_ORIGIN, state, light, &l_origin);
+	if (type == LIGHT_AREA_RECTANGLE) {
+		mi_query(miQ_LIGHT_AREA_R_EDGE_U, state, light, &l_u);
+		mi_query(miQ_LIGHT_AREA_R_EDGE_V, state, light, &l_v);
+	}
+	else {
+		mi_query(miQ_LIGHT_AREA_D_NORMAL, state, light, &l_normal);
+		mi_query(miQ_LIGHT_AREA_D_RADIUS, state, light, &radius);
+	}
+
+	miScalar *to_world = NULL;
+	if (mi_query(miQ_INST_LOCAL_TO_GLOBAL, state, light_instance, &to_world) && to_world) {
+		mi_point_transform(&origin, &l_origin, to_world);
+		mi_vector_transform(&u, &l_u, to_world);
+		mi_vector_transform(&v, &l_v, to_world);
+		mi_vector_transform(&normal, &l_normal, to_world);
+	}
+	else {
+		origin = l_origin;
+		u = l_u;
+		v = l_v;
+		normal = l_normal;
+	}
+
+	if (type == LIGHT_AREA_RECTANGLE) {
+		normal = Cross(u, v);
+		area = Magnitude(normal);
+	}
+	else {
+		area = Pi * radius * radius;
+	}
+
+	if (area <= 0.f)
+		return false;
+	normal = Normalize(normal);
+	return true;
+}
+
+miScalar MISLight::PlaneDistance(const miVector &p, const miVector &dir) const {
+	miScalar cos_l = Dot(dir, normal);
+	if (cos_l == 0.f)
+		return 0.f;
+	return std::max(Dot(origin - p, normal) / cos_l, 0.f);
+}
+
+bool MISLight::Hit(const miVector &p, const miVector &dir, miScalar *dist) const {
+	if (type == LIGHT_AREA_NONE)
+		return false;
+
+	miScalar t = PlaneDistance(p, dir);
+	if (t == 0.f)
+		return false;
+
+	miVector d = p + dir * t - origin;
+	if (type == LIGHT_AREA_RECTANGLE) {
+		if (std::abs(Dot(d, u)) > 0.5f * Dot(u, u) || std::abs(Dot(d, v)) > 0.5f * Dot(v, v))
+			return false;
+	}
+	else if (Dot(d, d) > radius * radius)
+		return false;
+
+	*dist = t;
+	return true;
+}
+
+void LightSampleBundle::Reserve(int n) {
+	color.Reserve(n);
+	dir.Reserve(n);
+	wi.Reserve(n);
+	dot_nl.Reserve(n);
+	weight.Reserve(n);
+	light.Reserve(n);
+}
+
+void LightSampleBundle::Gather(miState *state, int n_lights, miTag *light_tags) {
+	light_count = n_lights;
+	lights = light_tags;
+	light_samples.Reserve(light_count);
+	std::fill(light_samples.data(), light_samples.data() + light_count, 0);
+	count = 0;
+
+	miColor light_color;
+	miVector light_dir;
+	miScalar light_dot_nl;
+
+	for (int l = 0; l < light_count; l++) {
+		int first = count;
+		while (mi_sample_light(&light_color, &light_dir, &light_dot_nl, state, lights[l], &light_samples[l])) {
+			if (!notBlack(light_color))
+				continue;
+
+			Reserve(count + 1);
+			color[count] = light_color;
+			dir[count] = light_dir;
+			wi[count] = miWorldToLocal(state, light_dir);
+			dot_nl[count] = light_dot_nl;
+			light[count] = l;
+			count++;
+		}
+
+		if (light_samples[l])
+			std::fill(weight.data() + first, weight.data() + count, 1.f / light_samples[l]);
+		else
+			count = first;
+	}
+}
+
+// Power heuristic weight of a traced glossy sample, less than 1 only when it hit one of the lights
+static miScalar bsdf_mis_weight(miState *state, const miVector &dir, int nb, miScalar pdf_bsdf, const MISLight *lights, int light_count) {
+	if (!state->child)
+		return 1.f;
+
+	for (int i = 0; i < light_count; i++) {
+		miScalar dist;
+		if (lights[i].samples && lights[i].Hit(state->point, dir, &dist) && std::abs(state->child->dist - dist) <= 1e-3f * dist)
+			return PowerHeuristic(nb, pdf_bsdf, lights[i].samples, lights[i].Pdf(dir, dist));
+	}
+	return 1.f;
+}
+
+static inline miScalar luminance(const miColor &c) {
+	return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+}
+
+// Sample loop of the batched glossy lobes. mental ray decorrelates the rays traced from a
+// sample through the nesting of mi_sample, so they have to be traced inside the loop that
+// drew it. Draw() runs a complete loop to collect the samples for the batched BxDF call,
+// Next() then runs the same sequence again, stopping on each sample to trace it.
+class GlossySampleLoop {
+public:
+	GlossySampleLoop(miState *state, miUint nSamp) : state(state), nSamp(nSamp) {}
+
+	// Returns the number of samples drawn into u, at most nSamp
+	int Draw(Point2f *u) {
+		double samp[2];
+		int sample_number = 0, n = 0;
+
+		while (mi_sample(samp, &sample_number, state, 2, &nSamp)) {
+			if (n < (int)nSamp)
+				u[n++] = Point2f(samp[0], samp[1]);
+		}
+		return n;
+	}
+
+	// Steps to the next sample, returns false once mi_sample is done
+	bool Next(int *i) {
+		double samp[2];
+		if (!mi_sample(samp, &sample_number, state, 2, &nSamp))
+			return false;
+
+		*i = index++;
+		return true;
+	}
+
+private:
+	miState *state;
+	const miUint nSamp;
+	int sample_number = 0, index = 0;
+};
+
+// Running mean and variance (Welford) of the luminance of the glossy sample contributions.
+// With a zero threshold every sample is taken and the sum is divided by nSamp as before.
+class GlossyEstimate {
+public:
+	GlossyEstimate(const AdaptiveSampling *adaptive, miUint nSamp)
+		: threshold(adaptive ? adaptive->threshold : 0.f),
+		min_samples(adaptive ? std::max(adaptive->min_samples, 2) : 0),
+		nSamp(nSamp) {}
+
+	// Adds a sample contribution, returns true once the estimate has converged
+	bool Add(const miColor &c) {
+		sum += c;
+		n++;
+
+		if (threshold <= 0.f)
+			return false;
+
+		double y = luminance(c);
+		double delta = y - mean;
+		mean += delta / n;
+		m2 += delta * (y - mean);
+
+		if (n < min_samples)
+			return false;
+
+		// Relative standard error of the mean. It means nothing at a zero mean, where a run of
+		// black samples (rays missing a small bright object) would otherwise stop the loop
+		if (mean == 0.0)
+			return false;
+		return std::sqrt(m2 / ((n - 1) * (double)n)) < threshold * std::abs(mean);
+	}
+
+	int Count() const { return n; }
+
+	miColor Result() const {
+		if (threshold <= 0.f)
+			return sum / (miScalar)nSamp;
+		return n ? sum / (miScalar)n : BLA;
+	}
+
+private:
+	const miScalar threshold;
+	const int min_samples;
+	const miUint nSamp;
+	miColor sum = BLA;
+	int n = 0;
+	double mean = 0.0, m2 = 0.0;
+};
+
 // Calculate specular dielectric reflection
-miColor spec_dielectric_reflection(miState *state, miColor& reflect_k, miScalar eta) {
+miColor spec_dielectric_reflection(miState *state, miColor& reflect_k, miScalar eta, const FresnelTable *fr_table) {
 	if (PastReflDepth(state) || PastTraceDepth(state))
 		return BLA;
 
 
 	//Setup BSDF
-	FresnelDielectric fresnel(1.f, eta);
+	FresnelDielectric fresnel(1.f, eta, fr_table);
 	SpecularReflection refl(reflect_k, &fresnel);
 
 	Vector3f wi, wo = miWorldToLocal(state,-state->dir);
@@ -38,48 +299,119 @@ miColor spec_dielectric_reflection(miState *state, miColor& reflect_k, miScalar
 
 
 // Calculate glossy dielectric reflection
-miColor glossy_dielectric_reflection(miState *state, miColor& reflect_k, miScalar eta, miScalar roughness, int samples) {
+miColor glossy_dielectric_reflection(miState *state, miColor& reflect_k, miScalar eta, miScalar roughness, int samples, const FresnelTable *fr_table, const AdaptiveSampling *adaptive, const SampleBudget *budget,
+	const MISLight *mis_lights, int mis_light_count) {
 	if (PastReflDepth(state) || PastTraceDepth(state))
 		return BLA;
 
 	// Setup BSDF
-	FresnelDielectric fresnel(1.f, eta);
+	FresnelDielectric fresnel(1.f, eta, fr_table);
 	TrowbridgeReitzDistribution distrib(roughness, roughness);
-	MicrofacetReflection refl(reflect_k, &distrib, &fresnel);
+	MicrofacetReflectionT<TrowbridgeReitzDistribution, FresnelDielectric> refl(reflect_k, distrib, fresnel);
 
 
-	Vector3f wi, wo = miWorldToLocal(state, -state->dir);
-	miColor refl_sum = BLA, trace_res = BLA;
+	Vector3f wo = miWorldToLocal(state, -state->dir);
+	miColor trace_res = BLA;
 
 	// Setup Sampling
-	miScalar level = state->reflection_level + state->refraction_level;
-	const miUint nSamp = level == 0 ? samples : level == 1 ? std::max(samples / 2, 1) : 1;
-	double samp[2];
-	int sample_number = 0;
-
+	if (!budget)
+		budget = &default_budget;
+	const miUint nSamp = budget->Samples(state, samples);
+
+	// Generate every direction first, then trace them in the second pass
+	Point2f *u = ALLOCA(Point2f, nSamp);
+	Vector3f *wi = ALLOCA(Vector3f, nSamp);
+	miColor *f = ALLOCA(miColor, nSamp);
+	miScalar *pdf = ALLOCA(miScalar, nSamp);
+
+	GlossySampleLoop loop(state, nSamp);
+	int n = loop.Draw(u);
+	refl.Sample_f_batch(wo, n, u, wi, f, pdf);
+
+	// The MIS weights assume all nSamp traced samples, so stopping early
+	// would bias the sum; adaptive termination is off when they are applied
+	GlossyEstimate estimate(mis_lights ? NULL : adaptive, nSamp);
+	bool converged = false;
+	miScalar importance = state->importance;
 	miScalar temp = AbsDot(state->dir, state->normal);
-	while (mi_sample(samp, &sample_number, state, 2, &nSamp)) {
-		miVector trace_dir;
-		miScalar pdf = 0;
+	for (int i; loop.Next(&i);) {
+		if (converged || i >= n)
+			continue;
+
+		miColor contrib = BLA;
+		if (pdf[i]) {
+			miVector trace_dir = miLocalToWorld(state, wi[i]);
+			if (budget->throughput)
+				state->importance = importance * std::min(luminance(f[i]) * temp / pdf[i], 1.f);
+
+			bool hit = mi_trace_reflection(&trace_res, state, &trace_dir);
+			if (!hit)
+				mi_trace_environment(&trace_res, state, &trace_dir);
 
-		// Evaluate BSDF
-		miColor f = refl.Sample_f(wo, &wi, Point2f(samp[0], samp[1]), &pdf, NULL);
+			contrib = trace_res * (f[i] * temp / pdf[i]);
+			if (hit && mis_lights)
+				contrib *= bsdf_mis_weight(state, trace_dir, nSamp, pdf[i], mis_lights, mis_light_count);
+		}
 
-		if (pdf) {
-			trace_dir = miLocalToWorld(state, wi);
+		converged = estimate.Add(contrib);
+	}
+	state->importance = importance;
 
-			if (!mi_trace_reflection(&trace_res, state, &trace_dir))
-				mi_trace_environment(&trace_res, state, &trace_dir);
+	GLOSSY_SAMPLE_STAT(DielectricReflection, estimate.Count());
+	return estimate.Result();
+}
+
+
+// Calculate the light sampled half of MIS glossy dielectric reflection
+miColor glossy_dielectric_light_mis(miState *state, miColor& reflect_k, miScalar eta, miScalar roughness, int samples, const LightSampleBundle &bundle, MISLight *mis_lights, const SampleBudget *budget, const FresnelTable *fr_table) {
+	// Number of BSDF samples glossy_dielectric_reflection will trace
+	if (!budget)
+		budget = &default_budget;
+	const int nb = PastReflDepth(state) || PastTraceDepth(state) ? 0 : budget->Samples(state, samples);
+
+	// Lights whose shape can't be weighted keep samples at 0 and are left to the traced half
+	for (int l = 0; l < bundle.light_count; l++) {
+		if (mis_lights[l].Init(state, bundle.lights[l]))
+			mis_lights[l].samples = bundle.light_samples[l];
+	}
+
+	// Setup BSDF
+	FresnelDielectric fresnel(1.f, eta, fr_table);
+	TrowbridgeReitzDistribution distrib(roughness, roughness);
+	MicrofacetReflectionT<TrowbridgeReitzDistribution, FresnelDielectric> refl(reflect_k, distrib, fresnel);
+
+	Vector3f wo = miWorldToLocal(state, -state->dir);
 
-			refl_sum += trace_res * (f * temp / pdf);
+	int n = bundle.Count();
+	miColor *f = ALLOCA(miColor, n);
+	refl.f_batch(wo, n, bundle.wi.data(), f);
+
+	// The traced half weighs its samples by the cosine to the viewer, as the non-MIS lobe does.
+	// The power heuristic only sums to one if both halves estimate the same integrand, so the
+	// light samples use it too instead of their dot_nl
+	miScalar temp = AbsDot(state->dir, state->normal);
+
+	miColor ret = BLA;
+	for (int i = 0; i < n; i++) {
+		const MISLight &light = mis_lights[bundle.light[i]];
+		if (!light.samples || bundle.dot_nl[i] <= 0.f)
+			continue;
+
+		// Delta lights can't be hit by the traced samples and keep the full weight
+		miScalar w = 1.f;
+		if (light.type != LIGHT_AREA_NONE) {
+			miScalar t = light.PlaneDistance(state->point, bundle.dir[i]);
+			if (t > 0.f)
+				w = PowerHeuristic(light.samples, light.Pdf(bundle.dir[i], t), nb, refl.Pdf(wo, bundle.wi[i]));
 		}
+
+		ret += bundle.color[i] * f[i] * (temp * bundle.weight[i] * w);
 	}
 
-	return refl_sum / (miScalar)nSamp;
+	return ret;
 }
 
 
-
 // Calculate specular dielectric transmission
 miColor spec_dielectric_transmission(miState *state, miColor& refract_k, miScalar eta) {
 	if (PastRefrDepth(state) || PastTraceDepth(state))
@@ -113,52 +445,126 @@ miColor spec_dielectric_transmission(miState *state, miColor& refract_k, miScala
 }
 
 // Calculate glossy dielectric transmission
-miColor glossy_dielectric_transmission(miState *state, miColor& refract_k, miScalar eta, miScalar roughness, int samples) {
+miColor glossy_dielectric_transmission(miState *state, miColor& refract_k, miScalar eta, miScalar roughness, int samples, const FresnelTable *fr_table, const AdaptiveSampling *adaptive, const SampleBudget *budget) {
 	if (PastRefrDepth(state) || PastTraceDepth(state))
 		return BLA;
 
 	// Setup BSDF
-	FresnelDielectric fresnel(1.f, eta);
 	TrowbridgeReitzDistribution distrib(roughness, roughness);
-	MicrofacetTransmission tran(refract_k, &distrib, 1.f, eta, TransportMode::Radiance);
+	MicrofacetTransmissionT<TrowbridgeReitzDistribution> tran(refract_k, distrib, 1.f, eta, TransportMode::Radiance, fr_table);
 
-	Vector3f wi, wo = miWorldToLocal(state, -state->dir);
-	miColor refr_sum = BLA, trace_res = BLA;
+	Vector3f wo = miWorldToLocal(state, -state->dir);
+	miColor trace_res = BLA;
 
 	// Setup Sampling
-	miScalar level = state->reflection_level + state->refraction_level;
-	const miUint nSamp = level == 0 ? samples : level == 1 ? std::max(samples / 2, 1) : 1;
-	double samp[2];
-	int sample_number = 0;
-
-	int skip = 0;
-
+	if (!budget)
+		budget = &default_budget;
+	const miUint nSamp = budget->Samples(state, samples);
+
+	// Generate every direction first, then trace them in the second pass
+	Point2f *u = ALLOCA(Point2f, nSamp);
+	Vector3f *wi = ALLOCA(Vector3f, nSamp);
+	miColor *f = ALLOCA(miColor, nSamp);
+	miScalar *pdf = ALLOCA(miScalar, nSamp);
+
+	GlossySampleLoop loop(state, nSamp);
+	int n = loop.Draw(u);
+	tran.Sample_f_batch(wo, n, u, wi, f, pdf);
+
+	GlossyEstimate estimate(adaptive, nSamp);
+	bool converged = false;
+	miScalar importance = state->importance;
 	miScalar dot = AbsDot(state->dir, state->normal);
-	while (mi_sample(samp, &sample_number, state, 2, &nSamp)) {
-		miVector trace_dir;
-		miScalar pdf = 0;
+	for (int i; loop.Next(&i);) {
+		if (converged || i >= n)
+			continue;
 
-		// Evaluate BSDF
-		miColor f = tran.Sample_f(wo, &wi, Point2f(samp[0], samp[1]), &pdf, NULL);
-
-		if (pdf) {
-			trace_dir = miLocalToWorld(state, wi);
+		miColor contrib = BLA;
+		if (pdf[i]) {
+			miVector trace_dir = miLocalToWorld(state, wi[i]);
+			if (budget->throughput)
+				state->importance = importance * std::min(luminance(f[i]) * dot / pdf[i], 1.f);
 
 			mi_trace_refraction(&trace_res, state, &trace_dir);
-			refr_sum += trace_res * (f * dot / pdf);
+			contrib = trace_res * (f[i] * dot / pdf[i]);
 		}
-		else {
-			skip++;
+
+		converged = estimate.Add(contrib);
+	}
+	state->importance = importance;
+
+	GLOSSY_SAMPLE_STAT(DielectricTransmission, estimate.Count());
+	return estimate.Result();
+}
+
+
+// Calculate glossy dielectric reflection and transmission in one loop
+miColor glossy_dielectric_fresnel(miState *state, miColor& reflect_k, miColor& refract_k, miScalar eta, miScalar roughness, int samples, const FresnelTable *fr_table, const AdaptiveSampling *adaptive, const SampleBudget *budget) {
+	if (PastTraceDepth(state))
+		return BLA;
+
+	// A lobe past its depth still gets its share of the samples, it just returns black
+	bool past_refl = PastReflDepth(state), past_refr = PastRefrDepth(state);
+	if (past_refl && past_refr)
+		return BLA;
+
+	// Setup BSDF
+	TrowbridgeReitzDistribution distrib(roughness, roughness);
+	FresnelMicrofacetT<TrowbridgeReitzDistribution> bxdf(reflect_k, refract_k, distrib, 1.f, eta, TransportMode::Radiance, fr_table);
+
+	Vector3f wo = miWorldToLocal(state, -state->dir);
+	miColor trace_res = BLA;
+
+	// Setup Sampling
+	if (!budget)
+		budget = &default_budget;
+	const miUint nSamp = budget->Samples(state, samples);
+
+	// Sampled and traced one at a time, there is no batched Sample_f to feed
+	double samp[3];
+	int sample_number = 0;
+
+	GlossyEstimate estimate(adaptive, nSamp);
+	bool converged = false;
+	miScalar importance = state->importance;
+	miScalar dot = AbsDot(state->dir, state->normal);
+	while (mi_sample(samp, &sample_number, state, 3, &nSamp)) {
+		if (converged)
+			continue;
+
+		Vector3f wi;
+		miScalar pdf;
+		BxDFType type;
+		miColor f = bxdf.Sample_f(wo, &wi, Point2f(samp[0], samp[1]), samp[2], &pdf, &type);
+
+		miColor contrib = BLA;
+		bool reflected = pdf && (type & BSDF_REFLECTION);
+		if (pdf && (reflected ? !past_refl : !past_refr)) {
+			miVector trace_dir = miLocalToWorld(state, wi);
+			if (budget->throughput)
+				state->importance = importance * std::min(luminance(f) * dot / pdf, 1.f);
+
+			if (reflected) {
+				if (!mi_trace_reflection(&trace_res, state, &trace_dir))
+					mi_trace_environment(&trace_res, state, &trace_dir);
+			}
+			else
+				mi_trace_refraction(&trace_res, state, &trace_dir);
+
+			contrib = trace_res * (f * dot / pdf);
 		}
+
+		converged = estimate.Add(contrib);
 	}
+	state->importance = importance;
 
-	miColor ret = refr_sum / (miScalar)nSamp;
-	return ret;
+	GLOSSY_SAMPLE_STAT(DielectricFresnel, estimate.Count());
+	return estimate.Result();
 }
 
 
 // Calculate specular metal reflection
-miColor spec_metal_reflection(miState *state, miColor& eta, miColor& k) {
+miColor spec_metal_reflection(miState *state, miColor& eta, miColor& k, const FresnelTable *fr_table) {
 	miColor ret = BLA;
 
 
@@ -167,7 +573,7 @@ miColor spec_metal_reflection(miState *state, miColor& eta, miColor& k) {
 
 
 	// Setup BSDF
-	FresnelConductor frMf(WHI, eta, k);
+	FresnelConductor frMf(WHI, eta, k, fr_table);
 	SpecularReflection bxdf(WHI, &frMf);
 
 	Vector3f wi, wo = miWorldToLocal(state, -state->dir);
@@ -196,45 +602,62 @@ miColor spec_metal_reflection(miState *state, miColor& eta, miColor& k) {
 
 
 // Calculate glossy metal reflection
-miColor glossy_metal_reflection(miState *state, miColor& eta, miColor& k, miScalar roughness, int samples) {
+miColor glossy_metal_reflection(miState *state, miColor& eta, miColor& k, miScalar roughness, int samples, const FresnelTable *fr_table, const AdaptiveSampling *adaptive, const SampleBudget *budget) {
 	if (PastReflDepth(state) || PastTraceDepth(state))
 		return BLA;
 
 	miColor ret = BLA;
 	// Setup BSDF
-	FresnelConductor frMf(WHI, eta, k);
+	FresnelConductor frMf(WHI, eta, k, fr_table);
 	TrowbridgeReitzDistribution distrib(roughness, roughness);
-	MicrofacetReflection bxdf(WHI, &distrib, &frMf);
+	MicrofacetReflectionT<TrowbridgeReitzDistribution, FresnelConductor> bxdf(WHI, distrib, frMf);
 
-	Vector3f wi, wo = miWorldToLocal(state, -state->dir);
+	Vector3f wo = miWorldToLocal(state, -state->dir);
 
-	miColor refl_res = BLA, refl_sum = BLA;
+	miColor refl_res = BLA;
 
 	// Setup Sampling
-	miScalar level = state->reflection_level + state->refraction_level;
-	const miUint nSamp = level == 0 ? samples : level == 1 ? std::max(samples / 2, 1) : 1;
-	double samp[2];
-	int sample_number = 0;
-
-	while (mi_sample(samp, &sample_number, state, 2, &nSamp)) {
-		miVector refl_dir;
-		miScalar pdf = 0;
-
-		// Evaluate BSDF
-		miColor f = bxdf.Sample_f(wo, &wi, Point2f(samp[0], samp[1]), &pdf, NULL);
+	if (!budget)
+		budget = &default_budget;
+	const miUint nSamp = budget->Samples(state, samples);
+
+	// Generate every direction first, then trace them in the second pass
+	Point2f *u = ALLOCA(Point2f, nSamp);
+	Vector3f *wi = ALLOCA(Vector3f, nSamp);
+	miColor *f = ALLOCA(miColor, nSamp);
+	miScalar *pdf = ALLOCA(miScalar, nSamp);
+
+	GlossySampleLoop loop(state, nSamp);
+	int n = loop.Draw(u);
+	bxdf.Sample_f_batch(wo, n, u, wi, f, pdf);
+
+	GlossyEstimate estimate(adaptive, nSamp);
+	bool converged = false;
+	miScalar importance = state->importance;
+	miScalar dot = AbsDot(state->dir, state->normal);
+	for (int i; loop.Next(&i);) {
+		if (converged || i >= n)
+			continue;
 
 		// Trace reflection
-		if (pdf) {
-			refl_dir = miLocalToWorld(state, wi);
+		miColor contrib = BLA;
+		if (pdf[i]) {
+			miVector refl_dir = miLocalToWorld(state, wi[i]);
+			if (budget->throughput)
+				state->importance = importance * std::min(luminance(f[i]) * dot / pdf[i], 1.f);
 
 			if (!mi_trace_reflection(&refl_res, state, &refl_dir))
 				mi_trace_environment(&refl_res, state, &refl_dir);
 
-			refl_sum += refl_res * (f * AbsDot(state->dir, state->normal) / pdf);
+			contrib = refl_res * (f[i] * dot / pdf[i]);
 		}
+
+		converged = estimate.Add(contrib);
 	}
+	state->importance = importance;
 
-	ret = refl_sum / (miScalar)nSamp;
+	GLOSSY_SAMPLE_STAT(MetalReflection, estimate.Count());
+	ret = estimate.Result();
 	ret.a = 1.0;
 
 	return ret;
@@ -277,7 +700,15 @@ miColor lambertian_diffuse(miState *state, miColor& diffuse_k, int light_count,
 
 
 // Calculate Oren Nayar diffuse
-miColor orenNayar_diffuse(miState *state, miColor& diffuse_k, miScalar sigma, int light_count, miTag *lights) {
+miColor orenNayar_diffuse(miState *state, miColor& diffuse_k, miScalar sigma, int light_count, miTag *lights, const OrenNayarTerms *terms) {
+	LightSampleBundle bundle;
+	bundle.Gather(state, light_count, lights);
+
+	return orenNayar_diffuse(state, diffuse_k, sigma, bundle, terms);
+}
+
+// Calculate Oren Nayar diffuse from gathered light samples
+miColor orenNayar_diffuse(miState *state, miColor& diffuse_k, miScalar sigma, const LightSampleBundle &bundle, const OrenNayarTerms *terms) {
 	miColor ret = BLA;
 
 	// Compute global illumination
@@ -285,31 +716,17 @@ miColor orenNayar_diffuse(miState *state, miColor& diffuse_k, miScalar sigma, in
 	ret *= diffuse_k;
 
 	//Setup BSDF
-	OrenNayar diff(diffuse_k,sigma);
-
+	OrenNayar diff(diffuse_k, terms ? *terms : OrenNayarTerms::FromSigma(sigma));
 
-	//Sample lights
-	int light_sample_count;
-	miColor light_color, sum = BLA;
-	miVector light_dir;
-	miScalar dot_nl;
+	Vector3f wo = miWorldToLocal(state, -state->dir);
 
-	Vector3f wi, wo = miWorldToLocal(state, -state->dir);
-	miScalar temp = AbsDot(state->dir, state->normal);
+	// Evaluate the light samples
+	int n = bundle.Count();
+	miColor *f = ALLOCA(miColor, n);
+	diff.f_batch(wo, n, bundle.wi.data(), f);
 
-	for (int i = 0; i < light_count; i++, lights++) {
-		light_sample_count = 0;
-		while (mi_sample_light(&light_color, &light_dir, &dot_nl, state, *lights, &light_sample_count)) {
-			wi = miWorldToLocal(state, light_dir);
-			miColor f = diff.f(wo, wi);
-
-			sum += light_color * f * dot_nl;
-		}
-		if (light_sample_count) {
-			ret += sum / light_sample_count;
-		}
-		sum = BLA;
-	} 
+	for (int i = 0; i < n; i++)
+		ret += bundle.color[i] * f[i] * (bundle.dot_nl[i] * bundle.weight[i]);
 
 	return ret;
 }
@@ -8,21 +8,150 @@
 
 #include "slh_aux.h"
 #include <iostream>
-
+#include <algorithm>
+
+namespace pbrt { class FresnelTable; struct OrenNayarTerms; }
+
+
+// Adaptive sampling for the glossy lobes: tracing stops once the relative standard error of the
+// estimate falls below threshold, after at least min_samples and at most the depth-reduced sample count.
+// A threshold of 0 (or no AdaptiveSampling) always traces the full sample count, as does a lobe whose
+// samples have all been black so far.
+struct AdaptiveSampling {
+	miScalar threshold;
+	int min_samples;
+};
+
+// Number of glossy samples to take at the current ray depth: samples * falloff^level, one sample
+// past max_level, optionally scaled by the ray importance (the accumulated path weight, which the
+// glossy lobes lower for their child rays) and limited to a global cap (0 for none).
+// The defaults reproduce samples / 2 at the first bounce and 1 past it.
+struct SampleBudget {
+	miScalar falloff;
+	int max_level;
+	bool throughput;
+	int cap;
+
+	// Reads the render's string options slh_glossy_falloff, slh_glossy_max_level,
+	// slh_glossy_throughput and slh_glossy_cap over the defaults
+	static SampleBudget FromOptions(miState *state);
+
+	miUint Samples(const miState *state, int samples) const;
+};
+
+// A light as seen by the multiple importance sampled glossy lobes. Point, spot and directional
+// lights are only light sampled. Rectangle and disc area lights are also found by the traced
+// glossy rays, which assumes they are visible and physically based (a light sample returns the
+// radiance divided by its solid angle pdf). Other area shapes are left to the traced rays alone.
+struct MISLight {
+	int type;
+	miVector origin, normal, u, v;
+	miScalar radius, area;
+	int samples;	// Light samples taken at the current point
+
+	// Queries the light's shape, returns false if it can't be weighted
+	bool Init(miState *state, miTag light_instance);
+
+	// Distance along dir from p to the light's plane, 0 if it is behind p
+	miScalar PlaneDistance(const miVector &p, const miVector &dir) const;
+	bool Hit(const miVector &p, const miVector &dir, miScalar *dist) const;
+
+	// Solid angle pdf of a uniform sample on the light at dist along dir
+	miScalar Pdf(const miVector &dir, miScalar dist) const { return dist * dist / (area * AbsDot(dir, normal)); }
+};
+
+// Fixed-capacity storage on the stack that only moves to the heap when more than N elements are
+// needed, for per shading point arrays whose size is only known once they are filled
+template <typename T, int N>
+class InlineBuffer {
+public:
+	InlineBuffer() : ptr(local), capacity(N) {}
+	~InlineBuffer() { if (ptr != local) delete[] ptr; }
+
+	T *data() { return ptr; }
+	const T *data() const { return ptr; }
+	T &operator[](int i) { return ptr[i]; }
+	const T &operator[](int i) const { return ptr[i]; }
+
+	// Makes room for n elements, keeping the current ones
+	void Reserve(int n) {
+		if (n <= capacity)
+			return;
+		int grown = std::max(n, 2 * capacity);
+		T *p = new T[grown];
+		std::copy(ptr, ptr + capacity, p);
+		if (ptr != local)
+			delete[] ptr;
+		ptr = p;
+		capacity = grown;
+	}
+
+private:
+	InlineBuffer(const InlineBuffer &);
+	InlineBuffer &operator=(const InlineBuffer &);
+
+	T local[N];
+	T *ptr;
+	int capacity;
+};
+
+// Light samples gathered once per shading point (including their shadow rays) and shared by every
+// lobe of a material. Samples are kept in separate arrays so each lobe evaluates them with one
+// BxDF::f_batch call; samples that came back black are dropped. Up to INLINE_SAMPLES samples and
+// INLINE_LIGHTS lights are kept on the stack, so a typical point allocates nothing.
+struct LightSampleBundle {
+	enum { INLINE_SAMPLES = 32, INLINE_LIGHTS = 8 };
+
+	InlineBuffer<miColor, INLINE_SAMPLES>			color;
+	InlineBuffer<miVector, INLINE_SAMPLES>			dir;		// World space
+	InlineBuffer<pbrt::Vector3f, INLINE_SAMPLES>	wi;			// Local space
+	InlineBuffer<miScalar, INLINE_SAMPLES>			dot_nl;
+	InlineBuffer<miScalar, INLINE_SAMPLES>			weight;		// 1 / samples taken from the sample's light
+	InlineBuffer<int, INLINE_SAMPLES>				light;		// Index into lights
+
+	int				light_count;
+	miTag			*lights;
+	InlineBuffer<int, INLINE_LIGHTS>	light_samples;		// Samples taken per light
+
+	// Assumes state->derivs is filled in, see miWorldToLocal
+	void Gather(miState *state, int light_count, miTag *lights);
+	int Count() const { return count; }
+
+private:
+	void Reserve(int n);
+
+	int count;
+};
+
+// The optional fr_table is a per-instance Fresnel table built in the shader's _init function,
+// callers only pass it when it was built for the eta (and k) being shaded.
 
 // Dielectric reflection and transmission
-miColor spec_dielectric_reflection(miState *state, miColor& reflect_k, miScalar eta);
-miColor glossy_dielectric_reflection(miState *state, miColor& reflect_k, miScalar eta, miScalar roughness, int samples);
+miColor spec_dielectric_reflection(miState *state, miColor& reflect_k, miScalar eta, const pbrt::FresnelTable *fr_table = NULL);
+miColor glossy_dielectric_reflection(miState *state, miColor& reflect_k, miScalar eta, miScalar roughness, int samples, const pbrt::FresnelTable *fr_table = NULL, const AdaptiveSampling *adaptive = NULL, const SampleBudget *budget = NULL,
+	const MISLight *mis_lights = NULL, int mis_light_count = 0);
+
+// Multiple importance sampling of the glossy reflection's direct light: this light-sampling half fills in
+// mis_lights (one per bundle light), which are then passed to glossy_dielectric_reflection to weight its
+// traced (BSDF) half. The weights count on every traced sample, so glossy_dielectric_reflection ignores
+// its adaptive settings when given mis_lights
+miColor glossy_dielectric_light_mis(miState *state, miColor& reflect_k, miScalar eta, miScalar roughness, int samples, const LightSampleBundle &bundle, MISLight *mis_lights, const SampleBudget *budget = NULL, const pbrt::FresnelTable *fr_table = NULL);
+
 miColor spec_dielectric_transmission(miState *state, miColor& refract_k, miScalar eta);
-miColor glossy_dielectric_transmission(miState *state, miColor& refract_k, miScalar eta, miScalar roughness, int samples);
+miColor glossy_dielectric_transmission(miState *state, miColor& refract_k, miScalar eta, miScalar roughness, int samples, const pbrt::FresnelTable *fr_table = NULL, const AdaptiveSampling *adaptive = NULL, const SampleBudget *budget = NULL);
+
+// Glossy reflection and transmission sharing one sample loop: each sample picks one of the two with
+// probability equal to the microfacet Fresnel term, so samples rays are traced instead of twice that
+miColor glossy_dielectric_fresnel(miState *state, miColor& reflect_k, miColor& refract_k, miScalar eta, miScalar roughness, int samples, const pbrt::FresnelTable *fr_table = NULL, const AdaptiveSampling *adaptive = NULL, const SampleBudget *budget = NULL);
 
 // Metal reflection
-miColor spec_metal_reflection(miState *state, miColor& eta, miColor& k);
-miColor glossy_metal_reflection(miState *state, miColor& eta, miColor& k, miScalar roughness, int samples);
+miColor spec_metal_reflection(miState *state, miColor& eta, miColor& k, const pbrt::FresnelTable *fr_table = NULL);
+miColor glossy_metal_reflection(miState *state, miColor& eta, miColor& k, miScalar roughness, int samples, const pbrt::FresnelTable *fr_table = NULL, const AdaptiveSampling *adaptive = NULL, const SampleBudget *budget = NULL);
 
 // Diffuse lighting 
 miColor lambertian_diffuse(miState *state, miColor& diffuse_k, int light_count, miTag *light);
-miColor orenNayar_diffuse(miState *state, miColor& diffuse_k, miScalar sigma, int light_count, miTag *light);
+miColor orenNayar_diffuse(miState *state, miColor& diffuse_k, miScalar sigma, int light_count, miTag *light, const pbrt::OrenNayarTerms *terms = NULL);
+miColor orenNayar_diffuse(miState *state, miColor& diffuse_k, miScalar sigma, const LightSampleBundle &bundle, const pbrt::OrenNayarTerms *terms = NULL);
 
 
 // Convert between PBRT and Mental Ray types
@@ -1,5 +1,6 @@
 #include "slh_aux.h"
 #include "slh_pbrt.h"
+#include "core/reflection.h"
 #include <iostream>
 
 using namespace std;
@@ -15,12 +16,50 @@ struct slh_glass_params
 	miScalar	transmission_roughness;
 	int			transmission_samples;
 	miVector	bump;
+	miScalar	adaptive_threshold;
+	int			min_samples;
+	miBoolean	stochastic;
+};
+
+// Per-instance data built in slh_glass_init
+struct slh_glass_data
+{
+	FresnelTable	fr_table;
+	SampleBudget	budget;
+	miBoolean		eta_const;	// The table always matches
 };
 
 
 extern "C" DLLEXPORT
 int slh_glass_version(void) { return 1; }
 
+extern "C" DLLEXPORT
+miBoolean slh_glass_init(miState *state, struct slh_glass_params *params, miBoolean *instance_init_required)
+{
+	if (!params) {  /* Main shader init */
+		*instance_init_required = miTRUE;
+	}
+	else {  /* Shader instance init */
+		slh_glass_data *data = (slh_glass_data*)miaux_user_memory_pointer(state, sizeof(slh_glass_data));
+
+		// Tabulate the Fresnel term for the instance's eta, shading falls back
+		// to the exact equations if eta turns out to vary (shader-connected)
+		miScalar *eta = mi_eval_scalar(&params->eta);
+		data->eta_const = eta == &params->eta;
+		data->fr_table.InitDielectric(1.f, *eta);
+		mi_info("slh_glass: Fresnel table max error %g", data->fr_table.maxError);
+
+		data->budget = SampleBudget::FromOptions(state);
+	}
+	return miTRUE;
+}
+
+extern "C" DLLEXPORT
+miBoolean slh_glass_exit(miState *state, struct slh_glass_params *params)
+{
+	return miaux_release_user_memory("slh_glass", state, params);
+}
+
 extern "C" DLLEXPORT
 miBoolean slh_glass(miColor *result, miState *state, struct slh_glass_params *params)
 {
@@ -38,23 +77,40 @@ miBoolean slh_glass(miColor *result, miState *state, struct slh_glass_params *pa
 	miColor		reflect_k = *mi_eval_color(&params->reflect_k);
 	miColor		refract_k = *mi_eval_color(&params->refract_k);
 
+	slh_glass_data *data = (slh_glass_data*)miaux_user_memory_pointer(state, 0);
+	const FresnelTable *fr_table = &data->fr_table;
+	if (!data->eta_const && !fr_table->MatchesDielectric(1.f, eta))
+		fr_table = NULL;
+
+	AdaptiveSampling adaptive = { *mi_eval_scalar(&params->adaptive_threshold), *mi_eval_integer(&params->min_samples) };
+
+	miScalar	r_roughness = *mi_eval_scalar(&params->reflection_roughness);
+	miScalar	t_roughness = *mi_eval_scalar(&params->transmission_roughness);
+
+	// Reflection and transmission in one loop, needs both lobes rough with the same microfacet distribution
+	if (*mi_eval_boolean(&params->stochastic) && notBlack(reflect_k) && notBlack(refract_k) && r_roughness > 0.f && r_roughness == t_roughness) {
+		int samples = max(*mi_eval_integer(&params->reflection_samples), *mi_eval_integer(&params->transmission_samples));
+		*result = glossy_dielectric_fresnel(state, reflect_k, refract_k, eta, r_roughness, samples, fr_table, &adaptive, &data->budget);
+		result->a = 1.f;
+
+		return miTRUE;
+	}
+
 	miColor refl_res = BLA, refr_res = BLA;
 	
 	if (notBlack(reflect_k)) {
-		miScalar r_roughness = *mi_eval_scalar(&params->reflection_roughness);
 		if (r_roughness > 0.f) {
 			int	samples = *mi_eval_integer(&params->reflection_samples);
-			refl_res = glossy_dielectric_reflection(state, reflect_k, eta, r_roughness, samples);
+			refl_res = glossy_dielectric_reflection(state, reflect_k, eta, r_roughness, samples, fr_table, &adaptive, &data->budget);
 		}
 		else
-			refl_res = spec_dielectric_reflection(state, reflect_k, eta);
+			refl_res = spec_dielectric_reflection(state, reflect_k, eta, fr_table);
 	}
 
 	if (notBlack(refract_k)) {
-		miScalar t_roughness = *mi_eval_scalar(&params->transmission_roughness);
 		if (t_roughness > 0.f) {
 			int	samples = *mi_eval_integer(&params->transmission_samples);
-			refr_res = glossy_dielectric_transmission(state, refract_k, eta, t_roughness, samples);
+			refr_res = glossy_dielectric_transmission(state, refract_k, eta, t_roughness, samples, fr_table, &adaptive, &data->budget);
 		}
 		else
 			refr_res = spec_dielectric_transmission(state, refract_k, eta);
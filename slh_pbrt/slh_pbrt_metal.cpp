@@ -13,11 +13,48 @@ struct slh_metal_params
 	miScalar	roughness;
 	int			samples;
 	miVector	bump;
+	miScalar	adaptive_threshold;
+	int			min_samples;
+};
+
+// Per-instance data built in slh_metal_init
+struct slh_metal_data
+{
+	FresnelTable	fr_table;
+	SampleBudget	budget;
+	miBoolean		eta_k_const;	// The table always matches
 };
 
 extern "C" DLLEXPORT
 int slh_metal_version(void) { return 1; }
 
+extern "C" DLLEXPORT
+miBoolean slh_metal_init(miState *state, struct slh_metal_params *params, miBoolean *instance_init_required)
+{
+	if (!params) {  /* Main shader init */
+		*instance_init_required = miTRUE;
+	}
+	else {  /* Shader instance init */
+		slh_metal_data *data = (slh_metal_data*)miaux_user_memory_pointer(state, sizeof(slh_metal_data));
+
+		// Tabulate the Fresnel term for the instance's eta and k, shading falls
+		// back to the exact equations if they turn out to vary (shader-connected)
+		miColor *eta = mi_eval_color(&params->eta), *k = mi_eval_color(&params->k);
+		data->eta_k_const = eta == &params->eta && k == &params->k;
+		data->fr_table.InitConductor(WHI, *eta, *k);
+		mi_info("slh_metal: Fresnel table max error %g", data->fr_table.maxError);
+
+		data->budget = SampleBudget::FromOptions(state);
+	}
+	return miTRUE;
+}
+
+extern "C" DLLEXPORT
+miBoolean slh_metal_exit(miState *state, struct slh_metal_params *params)
+{
+	return miaux_release_user_memory("slh_metal", state, params);
+}
+
 extern "C" DLLEXPORT
 miBoolean slh_metal(miColor *result, miState *state, struct slh_metal_params *params)
 {
@@ -38,13 +75,18 @@ miBoolean slh_metal(miColor *result, miState *state, struct slh_metal_params *pa
 	miColor k = *mi_eval_color(&params->k);
 	miScalar roughness = *mi_eval_scalar(&params->roughness);
 
+	slh_metal_data *data = (slh_metal_data*)miaux_user_memory_pointer(state, 0);
+	const FresnelTable *fr_table = &data->fr_table;
+	if (!data->eta_k_const && !fr_table->MatchesConductor(WHI, eta, k))
+		fr_table = NULL;
 
 	if (roughness == 0.f) {
-		*result = spec_metal_reflection(state, eta, k);
+		*result = spec_metal_reflection(state, eta, k, fr_table);
 	}
 	else {
 		int samples = *mi_eval_integer(&params->samples);
-		*result = glossy_metal_reflection(state,eta,k,roughness,samples);
+		AdaptiveSampling adaptive = { *mi_eval_scalar(&params->adaptive_threshold), *mi_eval_integer(&params->min_samples) };
+		*result = glossy_metal_reflection(state,eta,k,roughness,samples,fr_table,&adaptive,&data->budget);
 	}
 
 	return miTRUE;
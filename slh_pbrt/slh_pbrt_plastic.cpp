@@ -17,16 +17,57 @@ struct slh_plastic_params
 	miScalar	sigma;
 	int			samples;
 	miVector	bump;
+	miScalar	adaptive_threshold;
+	int			min_samples;
+	miBoolean	mis;
 	int			i_light;
 	int			n_light;
 	miTag		lights[1];
 };
 
+// Per-instance data built in slh_plastic_init
+struct slh_plastic_data
+{
+	FresnelTable	fr_table;
+	OrenNayarTerms	oren_nayar;
+	SampleBudget	budget;
+	miBoolean		eta_const;		// The table always matches
+	miBoolean		sigma_const;	// oren_nayar can be used
+};
 
 
 extern "C" DLLEXPORT
 int slh_plastic_version(void) { return 1; }
 
+extern "C" DLLEXPORT
+miBoolean slh_plastic_init(miState *state, struct slh_plastic_params *params, miBoolean *instance_init_required)
+{
+	if (!params) {  /* Main shader init */
+		*instance_init_required = miTRUE;
+	}
+	else {  /* Shader instance init */
+		slh_plastic_data *data = (slh_plastic_data*)miaux_user_memory_pointer(state, sizeof(slh_plastic_data));
+
+		// Setup that only depends on parameters, shading redoes it for any that are shader-connected
+		miScalar *eta = mi_eval_scalar(&params->eta);
+		data->eta_const = eta == &params->eta;
+		data->fr_table.InitDielectric(1.f, *eta);
+
+		miScalar *sigma = mi_eval_scalar(&params->sigma);
+		data->sigma_const = sigma == &params->sigma;
+		data->oren_nayar = OrenNayarTerms::FromSigma(*sigma);
+
+		data->budget = SampleBudget::FromOptions(state);
+	}
+	return miTRUE;
+}
+
+extern "C" DLLEXPORT
+miBoolean slh_plastic_exit(miState *state, struct slh_plastic_params *params)
+{
+	return miaux_release_user_memory("slh_plastic", state, params);
+}
+
 extern "C" DLLEXPORT
 miBoolean slh_plastic(miColor *result, miState *state, struct slh_plastic_params *params)
 {
@@ -48,25 +89,48 @@ miBoolean slh_plastic(miColor *result, miState *state, struct slh_plastic_params
 	miScalar	roughness = *mi_eval_scalar(&params->roughness);
 	int			samples = *mi_eval_integer(&params->samples);
 
+	int			array_offset = *mi_eval_integer(&params->i_light);
+	int			light_count = *mi_eval_integer(&params->n_light);
+	miTag		*lights = mi_eval_tag(params->lights) + array_offset;
+
+	slh_plastic_data *data = (slh_plastic_data*)miaux_user_memory_pointer(state, 0);
+	const FresnelTable *fr_table = &data->fr_table;
+	if (!data->eta_const && !fr_table->MatchesDielectric(1.f, eta))
+		fr_table = NULL;
+
 	miColor reflect_res = BLA, diffuse_res = BLA;;
 
+	// Every light is sampled once, the diffuse lobe and the MIS highlight share the samples
+	bool mis = roughness > 0.f && notBlack(reflect_k) && *mi_eval_boolean(&params->mis);
+	LightSampleBundle bundle;
+	if (mis || notBlack(diffuse_k))
+		bundle.Gather(state, light_count, lights);
+
 	if (notBlack(reflect_k)) {
 		if (roughness == 0.f) {
-			reflect_res = spec_dielectric_reflection(state, reflect_k, eta);
+			reflect_res = spec_dielectric_reflection(state, reflect_k, eta, fr_table);
 		}
 		else {
-			reflect_res = glossy_dielectric_reflection(state, reflect_k, eta, roughness, samples);
+			AdaptiveSampling adaptive = { *mi_eval_scalar(&params->adaptive_threshold), *mi_eval_integer(&params->min_samples) };
+			const SampleBudget *budget = &data->budget;
+
+			if (mis) {
+				// Light sample the highlight too, weighted against the traced samples. Those weights
+				// assume every traced sample is taken, so there is no adaptive termination here
+				MISLight *mis_lights = ALLOCA(MISLight, light_count);
+				reflect_res = glossy_dielectric_light_mis(state, reflect_k, eta, roughness, samples, bundle, mis_lights, budget, fr_table);
+				reflect_res += glossy_dielectric_reflection(state, reflect_k, eta, roughness, samples, fr_table, NULL, budget, mis_lights, light_count);
+			}
+			else
+				reflect_res = glossy_dielectric_reflection(state, reflect_k, eta, roughness, samples, fr_table, &adaptive, budget);
 		}
 	}
 
 	if (notBlack(diffuse_k)) {
 		//Evaluate Params
 		miScalar sigma = *mi_eval_scalar(&params->sigma);
-		int array_offset = *mi_eval_integer(&params->i_light);
-		int light_count = *mi_eval_integer(&params->n_light);
-		miTag *lights = mi_eval_tag(params->lights) + array_offset;
 
-		diffuse_res = orenNayar_diffuse(state, diffuse_k, sigma, light_count, lights);
+		diffuse_res = orenNayar_diffuse(state, diffuse_k, sigma, bundle, data->sigma_const ? &data->oren_nayar : NULL);
 	}
 
 	*result = reflect_res + diffuse_res;